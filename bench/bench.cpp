@@ -0,0 +1,371 @@
+// Host benchmarks for jimp, the stop parser and DateTime. Runs the code in src/
+// against every *.json in the corpus directory (bench/corpus by default, see
+// bench/corpus.py) and prints one JSON object per line and benchmark:
+//
+//     {"bench":"parse_stops_pull","corpus":"synthetic-40.json","bytes":50843,
+//      "events":40,"runs":2000,"mb_per_s":312.4,"ns_per_event":4061.2,
+//      "allocs_per_parse":0,"peak_token_buffer":27}
+//
+// Compare two runs with bench/compare.py. Build and run with
+//
+//     pio run -e native -t exec
+//     .pio/build/native/program [corpus dir or files ...]
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "stop_parser.h"
+
+#define JIMP_IMPLEMENTATION
+#include "jimp.h"
+
+// peak_token_buffer comes from jimp.stats.
+#if !JIMP_STATS
+#error "Build with -D JIMP_STATS=1, see [env:native] in platformio.ini"
+#endif
+
+// Every benchmark runs for at least this long.
+static constexpr double MIN_SECONDS{0.5};
+// Size of the chunks push mode gets, what jimp_push_poll reads at most.
+static constexpr size_t PUSH_CHUNK{JIMP_INPUT_BUFFER_SIZE};
+// Same as fetchStops.
+static constexpr size_t ARENA_SIZE{256};
+
+// Allocation counting. glibc lets a program replace malloc and friends and
+// still reach the real ones.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+}
+
+static size_t allocations{0};
+
+extern "C" void *malloc(size_t size) {
+	allocations++;
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+	allocations++;
+	return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+	allocations++;
+	return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer) {
+	__libc_free(pointer);
+}
+
+struct Corpus {
+	std::string name;
+	std::vector<char> data;
+	size_t events;
+};
+
+struct Result {
+	size_t runs;
+	double seconds;
+	// Per run, from the first one.
+	size_t allocations;
+	// Longest token, see Jimp_Stats::peak_string.
+	size_t peakTokenBuffer;
+	size_t items;
+};
+
+static double now() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Calls run until MIN_SECONDS have passed. run returns false on failure and
+// puts what it wants reported into the Result it gets.
+template <typename Run>
+static bool measure(Result &result, Run run) {
+	result = Result{};
+	size_t const before = allocations;
+	if (!run(result)) return false;
+	result.allocations = allocations - before;
+
+	Result ignored{};
+	double const start = now();
+	double elapsed = 0;
+	size_t runs = 0;
+	do {
+		run(ignored);
+		runs++;
+		elapsed = now() - start;
+	} while (elapsed < MIN_SECONDS);
+
+	result.runs = runs;
+	result.seconds = elapsed;
+	return true;
+}
+
+static void report(char const *bench, Corpus const &corpus, Result const &result, char const *per) {
+	double const perRun = result.seconds / result.runs;
+	printf("{\"bench\":\"%s\",\"corpus\":\"%s\",\"bytes\":%zu,\"events\":%zu,\"runs\":%zu,"
+			"\"mb_per_s\":%.1f,\"ns_per_%s\":%.1f,\"allocs_per_parse\":%zu,\"peak_token_buffer\":%zu}\n",
+			bench, corpus.name.c_str(), corpus.data.size(), corpus.events, result.runs,
+			corpus.data.size() / perRun / 1e6, per, perRun * 1e9 / std::max<size_t>(result.items, 1),
+			result.allocations, result.peakTokenBuffer);
+	fflush(stdout);
+}
+
+static void failed(char const *bench, Corpus const &corpus) {
+	printf("{\"bench\":\"%s\",\"corpus\":\"%s\",\"error\":\"parse failed\"}\n",
+			bench, corpus.name.c_str());
+}
+
+// Stop parser ----------------------------------------------------------------
+
+static size_t stopEvents{0};
+
+static bool countStop(ParsedStopEvent const &, DateTime const &) {
+	stopEvents++;
+	return true;
+}
+
+static bool parseStopsPull(Corpus const &corpus, Jimp &jimp) {
+	DateTime serverLocalTime;
+	DateTime const nowUtc;
+	StopParserUserData userData{serverLocalTime, nowUtc, countStop, nullptr};
+	jimp_begin_memory(&jimp, corpus.data.data(), corpus.data.size(), &userData);
+	return parse_stops(&jimp);
+}
+
+static void benchStops(Corpus const &corpus) {
+	Result result;
+
+	// As fetchStops does it: fixed arena, long strings truncated.
+	bool ok = measure(result, [&](Result &r) {
+		char arena[ARENA_SIZE];
+		Jimp jimp = {};
+		jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+		bool const ok = parseStopsPull(corpus, jimp);
+		r.peakTokenBuffer = jimp.stats.peak_string;
+		r.items = corpus.events;
+		return ok;
+	});
+	if (ok) report("parse_stops_pull", corpus, result, "event");
+	else failed("parse_stops_pull", corpus);
+
+	// Without an arena jimp.string grows on the heap.
+	ok = measure(result, [&](Result &r) {
+		Jimp jimp = {};
+		bool const ok = parseStopsPull(corpus, jimp);
+		r.peakTokenBuffer = jimp.stats.peak_string;
+		r.items = corpus.events;
+		free(jimp.string);
+		return ok;
+	});
+	if (ok) report("parse_stops_pull_heap", corpus, result, "event");
+	else failed("parse_stops_pull_heap", corpus);
+
+	ok = measure(result, [&](Result &r) {
+		char arena[ARENA_SIZE];
+		Jimp jimp = {};
+		jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+		DateTime serverLocalTime;
+		DateTime const nowUtc;
+		StopParserUserData userData{serverLocalTime, nowUtc, countStop, nullptr};
+		StopPushParser parser;
+		parse_stops_push_begin(&jimp, &parser, &userData);
+
+		char const *p = corpus.data.data();
+		char const *end = p + corpus.data.size();
+		Jimp_Push_Status status = JIMP_PUSH_MORE;
+		while (p < end && status == JIMP_PUSH_MORE) {
+			size_t const n = std::min<size_t>(PUSH_CHUNK, end - p);
+			status = jimp_push_feed(&jimp, p, n);
+			p += n;
+		}
+		if (status == JIMP_PUSH_MORE) status = jimp_push_end(&jimp);
+		r.peakTokenBuffer = jimp.stats.peak_string;
+		r.items = corpus.events;
+		return status == JIMP_PUSH_DONE;
+	});
+	if (ok) report("parse_stops_push", corpus, result, "event");
+	else failed("parse_stops_push", corpus);
+}
+
+// jimp -----------------------------------------------------------------------
+
+static void benchJimp(Corpus const &corpus) {
+	Result result;
+
+	bool ok = measure(result, [&](Result &r) {
+		char arena[ARENA_SIZE];
+		Jimp jimp = {};
+		jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+		jimp_begin_memory(&jimp, corpus.data.data(), corpus.data.size());
+		size_t tokens = 0;
+		while (jimp__get_token(&jimp)) tokens++;
+		r.peakTokenBuffer = jimp.stats.peak_string;
+		r.items = tokens;
+		return jimp.cursor == jimp.end;
+	});
+	if (ok) report("jimp_get_token", corpus, result, "token");
+	else failed("jimp_get_token", corpus);
+
+	ok = measure(result, [&](Result &r) {
+		Jimp jimp = {};
+		jimp_begin_memory(&jimp, corpus.data.data(), corpus.data.size());
+		r.items = 1;
+		return jimp_skip_any(&jimp);
+	});
+	if (ok) report("jimp_skip_any", corpus, result, "document");
+	else failed("jimp_skip_any", corpus);
+
+	static constexpr char const *selectors[] = {
+		"serverInfo.serverTime",
+		"stopEvents[*].location.properties.platform",
+		"stopEvents[*].departureTimePlanned",
+		"stopEvents[*].departureTimeEstimated",
+		"stopEvents[*].transportation.number",
+	};
+	static constexpr Jimp_Paths paths = jimp_paths(selectors);
+	static_assert(paths.invalid == -1, "Invalid selector");
+
+	ok = measure(result, [&](Result &r) {
+		char arena[ARENA_SIZE];
+		Jimp jimp = {};
+		jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+		Jimp_Path_Match match;
+		jimp_paths_begin(&jimp, &match, &paths,
+			[](Jimp *, Jimp_Event, int, void *) { return JIMP_CONTINUE; });
+		Jimp_Push_Status status = jimp_push_feed(&jimp, corpus.data.data(), corpus.data.size());
+		if (status == JIMP_PUSH_MORE) status = jimp_push_end(&jimp);
+		r.peakTokenBuffer = jimp.stats.peak_string;
+		r.items = corpus.events;
+		return status == JIMP_PUSH_DONE;
+	});
+	if (ok) report("jimp_paths", corpus, result, "event");
+	else failed("jimp_paths", corpus);
+}
+
+// DateTime -------------------------------------------------------------------
+
+static void benchDateTime() {
+	// The formats the EFA uses: local serverTime and UTC stop event times.
+	std::vector<std::string> timestamps;
+	for (int i = 0; i < 1000; i++) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "2025-%02d-%02dT%02d:%02d:%02d%s",
+				1 + i % 12, 1 + i % 28, i % 24, i % 60, (i * 7) % 60, i % 2 ? "Z" : "");
+		timestamps.push_back(buffer);
+	}
+
+	Corpus const corpus{"timestamps", {}, timestamps.size()};
+	Result result;
+	uint32_t sink = 0;
+
+	measure(result, [&](Result &r) {
+		for (std::string const &timestamp : timestamps) {
+			sink += DateTime(timestamp.c_str()).second();
+		}
+		r.items = timestamps.size();
+		return true;
+	});
+	report("datetime_parse", corpus, result, "op");
+
+	std::vector<DateTime> times;
+	for (std::string const &timestamp : timestamps) times.push_back(DateTime(timestamp.c_str()));
+	DateTime const reference("2025-06-15T12:00:00");
+
+	measure(result, [&](Result &r) {
+		for (DateTime const &time : times) {
+			sink += (time - reference).totalseconds() / 60;
+			sink += (time + TimeSpan(60)).minute();
+		}
+		r.items = times.size();
+		return true;
+	});
+	report("datetime_arithmetic", corpus, result, "op");
+
+	if (sink == 1) puts("");
+}
+
+// ----------------------------------------------------------------------------
+
+static bool load(char const *path, std::vector<Corpus> &corpora) {
+	FILE *file = fopen(path, "rb");
+	if (!file) return false;
+
+	Corpus corpus;
+	char const *slash = strrchr(path, '/');
+	corpus.name = slash ? slash + 1 : path;
+	char buffer[1 << 16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		corpus.data.insert(corpus.data.end(), buffer, buffer + n);
+	}
+	fclose(file);
+
+	// Count the stop events once, for the per event numbers.
+	char arena[ARENA_SIZE];
+	Jimp jimp = {};
+	jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+	stopEvents = 0;
+	parseStopsPull(corpus, jimp);
+	corpus.events = stopEvents;
+
+	corpora.push_back(std::move(corpus));
+	return true;
+}
+
+static void loadDirectory(char const *path, std::vector<Corpus> &corpora) {
+	DIR *dir = opendir(path);
+	if (!dir) return;
+
+	std::vector<std::string> files;
+	while (dirent *entry = readdir(dir)) {
+		size_t const length = strlen(entry->d_name);
+		if (length > 5 && strcmp(entry->d_name + length - 5, ".json") == 0) {
+			files.push_back(std::string(path) + "/" + entry->d_name);
+		}
+	}
+	closedir(dir);
+
+	std::sort(files.begin(), files.end());
+	for (std::string const &file : files) load(file.c_str(), corpora);
+}
+
+int main(int argc, char **argv) {
+	std::vector<Corpus> corpora;
+	if (argc < 2) {
+		loadDirectory("bench/corpus", corpora);
+	}
+	for (int i = 1; i < argc; i++) {
+		DIR *dir = opendir(argv[i]);
+		if (dir) {
+			closedir(dir);
+			loadDirectory(argv[i], corpora);
+		} else if (!load(argv[i], corpora)) {
+			fprintf(stderr, "Could not read %s\n", argv[i]);
+		}
+	}
+	if (corpora.empty()) {
+		fprintf(stderr, "No corpus found. Run python bench/corpus.py first.\n");
+		return 1;
+	}
+
+	for (Corpus const &corpus : corpora) {
+		benchJimp(corpus);
+		benchStops(corpus);
+	}
+	benchDateTime();
+	return 0;
+}
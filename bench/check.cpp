@@ -0,0 +1,911 @@
+// Differential checks on the host. Every part that can take its input in
+// arbitrary pieces is run against something that doesn't, with random piece
+// sizes from a fixed seed, and the results have to agree:
+//
+//  - the stop parser in push mode against pull mode, on every *.json in the
+//    corpus directory (bench/corpus by default, see bench/corpus.py), with and
+//    without a platform filter and with callbacks that stop early
+//  - every JIMP_SCAN kernel the host can run against the scalar one, on the
+//    corpus and on random documents full of escapes, long strings and
+//    whitespace, see check_scan.cpp
+//  - path projection against a pull mode walk that compares the path with the
+//    selectors, on the corpus and on random documents made for sets of
+//    selectors that are prefixes of each other or have colliding names
+//  - HttpBody against the payload it frames, with the connection handing
+//    out a few bytes at a time
+//  - inflate against zlib, which compresses the corpus and random data with
+//    every strategy, and on a stream with the longest distance codes there
+//    are, which zlib doesn't send
+//
+// Prints a line per check and exits with 1 if any of them failed. Build and run
+// with
+//
+//     pio run -e native_check -t exec
+//     .pio/build/native_check/program [seed [corpus dir or files ...]]
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "http_body.h"
+#include "inflate.h"
+#include "stop_parser.h"
+
+#define JIMP_IMPLEMENTATION
+#include "jimp.h"
+
+// Random documents checked on top of the corpus, and how often every corpus
+// document is pushed in different pieces.
+static constexpr int RANDOM_DOCUMENTS{200};
+static constexpr int CHUNKINGS{20};
+// Random documents for every set of path selectors.
+static constexpr int RANDOM_PATHS_DOCUMENTS{300};
+// Same as fetchStops.
+static constexpr size_t ARENA_SIZE{256};
+static constexpr size_t INFLATE_WINDOW_SIZE{32 * 1024};
+static constexpr size_t INFLATE_INPUT_SIZE{256};
+// Random data compressed with zlib on top of the corpus.
+static constexpr int RANDOM_STREAMS{20};
+
+size_t firstDifference(std::string const &a, std::string const &b) {
+	size_t i = 0;
+	while (i < a.size() && i < b.size() && a[i] == b[i]) i++;
+	return i;
+}
+
+static bool load(char const *path, std::vector<Document> &documents) {
+	FILE *file = fopen(path, "rb");
+	if (!file) return false;
+
+	Document document;
+	char const *slash = strrchr(path, '/');
+	document.name = slash ? slash + 1 : path;
+	char buffer[1 << 16];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) document.data.append(buffer, n);
+	fclose(file);
+
+	documents.push_back(std::move(document));
+	return true;
+}
+
+static void loadDirectory(char const *path, std::vector<Document> &documents) {
+	DIR *dir = opendir(path);
+	if (!dir) return;
+
+	std::vector<std::string> files;
+	while (dirent *entry = readdir(dir)) {
+		size_t const length = strlen(entry->d_name);
+		if (length > 5 && strcmp(entry->d_name + length - 5, ".json") == 0) {
+			files.push_back(std::string(path) + "/" + entry->d_name);
+		}
+	}
+	closedir(dir);
+
+	std::sort(files.begin(), files.end());
+	for (std::string const &file : files) load(file.c_str(), documents);
+}
+
+static void report(char const *check, std::string const &name, bool ok) {
+	printf("%-8s %-32s %s\n", check, name.c_str(), ok ? "ok" : "FAILED");
+	fflush(stdout);
+}
+
+// Stop parser, push against pull ---------------------------------------------
+
+// What a parse handed out, one line per stop event.
+static std::string stops;
+// Stop events left until the callback has enough, negative for never.
+static int stopsLeft;
+
+static bool recordStop(ParsedStopEvent const &stopEvent, DateTime const &) {
+	char line[96];
+	snprintf(line, sizeof(line), "%c %d %lu %d %lu\n", stopEvent.platform, stopEvent.number,
+			(unsigned long)stopEvent.departureTimePlanned.unixtime(), stopEvent.hasDepartureTimeEstimated,
+			(unsigned long)stopEvent.departureTimeEstimated.unixtime());
+	stops += line;
+	return stopsLeft < 0 || --stopsLeft > 0;
+}
+
+static bool platformAorC(char platform) {
+	return platform == 'a' || platform == 'c';
+}
+
+struct StopsRun {
+	bool (*platformFilter)(char);
+	int stopAfter;
+};
+
+static std::string finish(Jimp const &jimp, DateTime const &serverLocalTime, bool ok) {
+	char line[96];
+	snprintf(line, sizeof(line), "ok %d stopped %d server time %lu\n", ok, jimp.stopped,
+			(unsigned long)serverLocalTime.unixtime());
+	return stops + line;
+}
+
+static std::string pullStops(Document const &document, StopsRun const &run) {
+	DateTime serverLocalTime;
+	DateTime const nowUtc;
+	StopParserUserData userData{serverLocalTime, nowUtc, recordStop, run.platformFilter};
+	char arena[ARENA_SIZE];
+	Jimp jimp = {};
+	jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+	jimp_begin_memory(&jimp, document.data.data(), document.data.size(), &userData);
+	stops.clear();
+	stopsLeft = run.stopAfter;
+	bool const ok = parse_stops(&jimp);
+	return finish(jimp, serverLocalTime, ok);
+}
+
+static std::string pushStops(Document const &document, StopsRun const &run, std::mt19937 &random) {
+	DateTime serverLocalTime;
+	DateTime const nowUtc;
+	StopParserUserData userData{serverLocalTime, nowUtc, recordStop, run.platformFilter};
+	char arena[ARENA_SIZE];
+	Jimp jimp = {};
+	jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+	StopPushParser parser;
+	parse_stops_push_begin(&jimp, &parser, &userData);
+	stops.clear();
+	stopsLeft = run.stopAfter;
+
+	Jimp_Push_Status status = JIMP_PUSH_MORE;
+	for (size_t at = 0; at < document.data.size() && status == JIMP_PUSH_MORE; ) {
+		size_t const size = std::min<size_t>(random() % 600 + 1, document.data.size() - at);
+		status = jimp_push_feed(&jimp, document.data.data() + at, size);
+		at += size;
+	}
+	if (status == JIMP_PUSH_MORE) status = jimp_push_end(&jimp);
+	return finish(jimp, serverLocalTime, status == JIMP_PUSH_DONE);
+}
+
+static bool checkStops(Document const &document, std::mt19937 &random) {
+	StopsRun const runs[] = {
+		{nullptr, -1},
+		{platformAorC, -1},
+		{nullptr, 3},
+		{platformAorC, 2},
+	};
+	bool ok = true;
+	for (StopsRun const &run : runs) {
+		std::string const expected = pullStops(document, run);
+		for (int i = 0; i < CHUNKINGS; i++) {
+			std::string const got = pushStops(document, run, random);
+			if (got == expected) continue;
+			fprintf(stderr, "stops %s: push differs from pull at byte %zu\n",
+					document.name.c_str(), firstDifference(got, expected));
+			ok = false;
+			break;
+		}
+	}
+	return ok;
+}
+
+// Random documents -----------------------------------------------------------
+
+static void randomWhitespace(std::mt19937 &random, std::string &out) {
+	static const char whitespace[] = " \t\r\n";
+	int const count = random() % 4 == 0 ? random() % 70 : random() % 2;
+	for (int i = 0; i < count; i++) out += whitespace[random() % 4];
+}
+
+// A string with escapes, quotes and backslashes in all places, sometimes
+// longer than the arena or the input buffer.
+static void randomString(std::mt19937 &random, std::string &out) {
+	static const char *const pieces[] = {
+		"\\\"", "\\\\", "\\/", "\\n", "\\t", "\\b\\f", "\\r", "\xc3\xa4", "\xe2\x82\xac",
+	};
+	int const length = random() % 8 == 0 ? random() % 600 : random() % 24;
+	out += '"';
+	for (int i = 0; i < length; i++) {
+		if (random() % 6 == 0) {
+			out += pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))];
+		} else {
+			char c = (char)(' ' + random() % 95);
+			if (c == '"' || c == '\\') c = 'x';
+			out += c;
+		}
+	}
+	out += '"';
+}
+
+static void randomValue(std::mt19937 &random, std::string &out, int depth) {
+	int const kind = depth > 6 ? random() % 4 : random() % 6;
+	randomWhitespace(random, out);
+	switch (kind) {
+	case 0:
+		randomString(random, out);
+		break;
+	case 1: {
+		static const char *const numbers[] = {"0", "-1", "42", "3.25", "-0.5e-3", "1E10", "123456789012"};
+		out += numbers[random() % (sizeof(numbers) / sizeof(numbers[0]))];
+		break;
+	}
+	case 2:
+		out += random() % 2 ? "true" : "false";
+		break;
+	case 3:
+		out += "null";
+		break;
+	case 4: {
+		out += '{';
+		int const count = random() % 6;
+		for (int i = 0; i < count; i++) {
+			if (i > 0) out += ',';
+			randomWhitespace(random, out);
+			randomString(random, out);
+			randomWhitespace(random, out);
+			out += ':';
+			randomValue(random, out, depth + 1);
+		}
+		randomWhitespace(random, out);
+		out += '}';
+		break;
+	}
+	default: {
+		out += '[';
+		int const count = random() % 6;
+		for (int i = 0; i < count; i++) {
+			if (i > 0) out += ',';
+			randomValue(random, out, depth + 1);
+		}
+		randomWhitespace(random, out);
+		out += ']';
+		break;
+	}
+	}
+	randomWhitespace(random, out);
+}
+
+static Document randomDocument(std::mt19937 &random, int index) {
+	Document document;
+	document.name = "random-" + std::to_string(index);
+	document.data += '{';
+	int const count = 1 + random() % 8;
+	for (int i = 0; i < count; i++) {
+		if (i > 0) document.data += ',';
+		randomString(random, document.data);
+		document.data += ':';
+		randomValue(random, document.data, 1);
+	}
+	document.data += '}';
+	return document;
+}
+
+// Path projection, push against a pull mode walk -----------------------------
+
+// Member names of the documents made for the selectors below. liquid and
+// costarring have the same jimp_hash.
+static const char *const pathNames[] = {"a", "b", "c", "liquid", "costarring"};
+static_assert(jimp_hash("liquid") == jimp_hash("costarring"), "No collision to check");
+
+// Prefixes of each other, [*] at every level and the colliding names.
+static constexpr const char *pathSelectors0[] = {"a", "a.b", "c[*].b", "liquid"};
+static constexpr const char *pathSelectors1[] = {"a.b.c", "c[*]", "c[*].a", "costarring", "[*].liquid"};
+static constexpr const char *pathSelectors2[] = {"b[*][*]", "b.b", "liquid.a", "[*]"};
+// What the stop parser reads.
+static constexpr const char *pathSelectorsStops[] = {
+	"serverInfo.serverTime",
+	"stopEvents[*].location.properties.platform",
+	"stopEvents[*].departureTimePlanned",
+	"stopEvents[*].departureTimeEstimated",
+	"stopEvents[*].transportation.number",
+};
+
+struct PathSelectors {
+	const char *const *selectors;
+	size_t count;
+	Jimp_Paths paths;
+};
+
+template <size_t N>
+static constexpr PathSelectors pathSelectors(const char *const (&selectors)[N]) {
+	return PathSelectors{selectors, N, jimp_paths(selectors)};
+}
+
+static constexpr PathSelectors pathSelectorSets[] = {
+	pathSelectors(pathSelectors0),
+	pathSelectors(pathSelectors1),
+	pathSelectors(pathSelectors2),
+};
+static constexpr PathSelectors stopsSelectors = pathSelectors(pathSelectorsStops);
+static_assert(pathSelectorSets[0].paths.invalid == -1 && pathSelectorSets[1].paths.invalid == -1
+		&& pathSelectorSets[2].paths.invalid == -1 && stopsSelectors.paths.invalid == -1, "Invalid selector");
+
+// Small, so that long names and values get truncated.
+static constexpr size_t PATHS_ARENA_SIZE{64};
+
+// One line per event a selector gets.
+static void recordPathEvent(Jimp *jimp, Jimp_Event event, int selector, std::string &out) {
+	char line[48];
+	snprintf(line, sizeof(line), "%d %d ", selector, (int)event);
+	out += line;
+	switch (event) {
+	case JIMP_EVENT_MEMBER:
+	case JIMP_EVENT_STRING:
+		out.append(jimp->string, jimp->string_count);
+		if (jimp->truncated) out += '~';
+		break;
+	case JIMP_EVENT_NUMBER:
+		snprintf(line, sizeof(line), "%.17g", jimp->number);
+		out += line;
+		break;
+	case JIMP_EVENT_BOOL:
+		out += jimp->boolean ? "true" : "false";
+		break;
+	default:
+		break;
+	}
+	out += '\n';
+}
+
+static Jimp_Action pathSink(Jimp *jimp, Jimp_Event event, int selector, void *userData) {
+	recordPathEvent(jimp, event, selector, *static_cast<std::string *>(userData));
+	return JIMP_CONTINUE;
+}
+
+static std::string pushPaths(std::string const &document, PathSelectors const &selectors, std::mt19937 &random) {
+	std::string out;
+	char arena[PATHS_ARENA_SIZE];
+	Jimp jimp = {};
+	jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+	Jimp_Path_Match match;
+	jimp_paths_begin(&jimp, &match, &selectors.paths, pathSink, &out);
+	Jimp_Push_Status status = JIMP_PUSH_MORE;
+	for (size_t at = 0; at < document.size() && status == JIMP_PUSH_MORE; ) {
+		size_t const size = std::min<size_t>(random() % 300 + 1, document.size() - at);
+		status = jimp_push_feed(&jimp, document.data() + at, size);
+		at += size;
+	}
+	if (status == JIMP_PUSH_MORE) status = jimp_push_end(&jimp);
+	return out + "status " + std::to_string((int)status) + "\n";
+}
+
+// All events of the value ahead, the way the sink of a selected value gets
+// them.
+static bool dumpPull(Jimp *jimp, int selector, std::string &out) {
+	if (jimp_is_object_ahead(jimp)) {
+		if (!jimp_object_begin(jimp)) return false;
+		recordPathEvent(jimp, JIMP_EVENT_OBJECT_BEGIN, selector, out);
+		while (jimp_object_member(jimp)) {
+			recordPathEvent(jimp, JIMP_EVENT_MEMBER, selector, out);
+			if (!dumpPull(jimp, selector, out)) return false;
+		}
+		if (!jimp_object_end(jimp)) return false;
+		recordPathEvent(jimp, JIMP_EVENT_OBJECT_END, selector, out);
+		return true;
+	}
+	if (jimp_is_array_ahead(jimp)) {
+		if (!jimp_array_begin(jimp)) return false;
+		recordPathEvent(jimp, JIMP_EVENT_ARRAY_BEGIN, selector, out);
+		while (jimp_array_item(jimp)) {
+			if (!dumpPull(jimp, selector, out)) return false;
+		}
+		if (!jimp_array_end(jimp)) return false;
+		recordPathEvent(jimp, JIMP_EVENT_ARRAY_END, selector, out);
+		return true;
+	}
+	if (jimp_is_string_ahead(jimp)) {
+		if (!jimp_string(jimp)) return false;
+		recordPathEvent(jimp, JIMP_EVENT_STRING, selector, out);
+		return true;
+	}
+	if (jimp_is_number_ahead(jimp)) {
+		if (!jimp_number(jimp)) return false;
+		recordPathEvent(jimp, JIMP_EVENT_NUMBER, selector, out);
+		return true;
+	}
+	if (jimp_is_bool_ahead(jimp)) {
+		if (!jimp_bool(jimp)) return false;
+		recordPathEvent(jimp, JIMP_EVENT_BOOL, selector, out);
+		return true;
+	}
+	recordPathEvent(jimp, JIMP_EVENT_NULL, selector, out);
+	return jimp_skip_any(jimp);
+}
+
+// Walks the whole value ahead and keeps track of its path in selector syntax.
+// A path that no selector can match, because a name was truncated or has a
+// `.` or `[` in it, is empty.
+static bool selectPull(Jimp *jimp, PathSelectors const &selectors, std::string const &path, std::string &out) {
+	for (size_t i = 0; i < selectors.count && !path.empty(); i++) {
+		if (path == selectors.selectors[i]) return dumpPull(jimp, (int)i, out);
+	}
+	bool const root = path == "/";
+	if (jimp_is_object_ahead(jimp)) {
+		if (!jimp_object_begin(jimp)) return false;
+		while (jimp_object_member(jimp)) {
+			std::string const name(jimp->string, jimp->string_count);
+			bool const matchable = !path.empty() && !jimp->truncated && name.find_first_of(".[") == std::string::npos;
+			std::string const member = !matchable ? "" : root ? name : path + "." + name;
+			if (!selectPull(jimp, selectors, member, out)) return false;
+		}
+		return jimp_object_end(jimp);
+	}
+	if (jimp_is_array_ahead(jimp)) {
+		if (!jimp_array_begin(jimp)) return false;
+		std::string const element = path.empty() ? "" : root ? "[*]" : path + "[*]";
+		while (jimp_array_item(jimp)) {
+			if (!selectPull(jimp, selectors, element, out)) return false;
+		}
+		return jimp_array_end(jimp);
+	}
+	return jimp_skip_any(jimp);
+}
+
+static std::string pullPaths(std::string const &document, PathSelectors const &selectors) {
+	std::string out;
+	char arena[PATHS_ARENA_SIZE];
+	Jimp jimp = {};
+	jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+	jimp_begin_memory(&jimp, document.data(), document.size());
+	bool const ok = selectPull(&jimp, selectors, "/", out);
+	return out + "status " + std::to_string((int)(ok ? JIMP_PUSH_DONE : JIMP_PUSH_ERROR)) + "\n";
+}
+
+static bool checkPaths(Document const &document, PathSelectors const &selectors, std::mt19937 &random) {
+	std::string const expected = pullPaths(document.data, selectors);
+	for (int i = 0; i < CHUNKINGS; i++) {
+		std::string const got = pushPaths(document.data, selectors, random);
+		if (got == expected) continue;
+		fprintf(stderr, "paths %s: push differs from pull at byte %zu\n",
+				document.name.c_str(), firstDifference(got, expected));
+		return false;
+	}
+	return true;
+}
+
+// Mostly members named after pathNames, so that the selectors find something.
+static void randomPathsValue(std::mt19937 &random, std::string &out, int depth) {
+	int const kind = depth > 4 ? 2 : random() % 3;
+	if (kind == 0) {
+		out += '{';
+		int const count = random() % 5;
+		for (int i = 0; i < count; i++) {
+			if (i > 0) out += ',';
+			if (random() % 8 == 0) {
+				randomString(random, out);
+			} else {
+				out += '"';
+				out += pathNames[random() % (sizeof(pathNames) / sizeof(pathNames[0]))];
+				out += '"';
+			}
+			randomWhitespace(random, out);
+			out += ':';
+			randomPathsValue(random, out, depth + 1);
+		}
+		out += '}';
+	} else if (kind == 1) {
+		out += '[';
+		int const count = random() % 4;
+		for (int i = 0; i < count; i++) {
+			if (i > 0) out += ',';
+			randomPathsValue(random, out, depth + 1);
+		}
+		out += ']';
+	} else {
+		randomValue(random, out, depth + 2);
+	}
+}
+
+static Document randomPathsDocument(std::mt19937 &random, int index) {
+	Document document;
+	document.name = "random-" + std::to_string(index);
+	// Containers at the top, with a few exceptions.
+	do {
+		document.data.clear();
+		randomPathsValue(random, document.data, 0);
+	} while (random() % 8 != 0 && document.data[0] != '{' && document.data[0] != '[');
+	return document;
+}
+
+// inflate --------------------------------------------------------------------
+
+static bool appendOutput(const char *data, size_t size, void *userData) {
+	static_cast<std::string *>(userData)->append(data, size);
+	return true;
+}
+
+struct Inflater {
+	Inflate inflate;
+	char window[INFLATE_WINDOW_SIZE];
+};
+
+// Runs stream through inflate in pieces of chunk bytes, random sizes if 0.
+static std::string inflateChunked(std::string const &stream, InflateFormat format, size_t chunk,
+		std::mt19937 &random, InflateStatus *status) {
+	std::string out;
+	std::unique_ptr<Inflater> inflater(new Inflater);
+	inflate_begin(&inflater->inflate, format, inflater->window, sizeof(inflater->window), appendOutput, &out);
+	*status = INFLATE_MORE;
+	for (size_t at = 0; at < stream.size() && *status == INFLATE_MORE; ) {
+		size_t const size = std::min<size_t>(chunk ? chunk : random() % 1500 + 1, stream.size() - at);
+		*status = inflate_feed(&inflater->inflate, stream.data() + at, size);
+		at += size;
+	}
+	return out;
+}
+
+static bool checkInflate(std::string const &name, std::string const &stream, InflateFormat format,
+		std::string const &expected, std::mt19937 &random) {
+	// One byte at a time, what a socket hands out in one go and everything at
+	// once, and random sizes in between.
+	static const size_t chunks[] = {1, 3, INFLATE_INPUT_SIZE, 4096, SIZE_MAX, 0, 0, 0};
+	for (size_t chunk : chunks) {
+		InflateStatus status;
+		std::string const got = inflateChunked(stream, format, chunk, random, &status);
+		if (status == INFLATE_DONE && got == expected) continue;
+		fprintf(stderr, "inflate %s: %zu byte chunks end with status %d after %zu of %zu bytes,"
+				" differing at byte %zu\n", name.c_str(), chunk, status, got.size(), expected.size(),
+				firstDifference(got, expected));
+		return false;
+	}
+	return true;
+}
+
+// Compresses data with zlib. windowBits picks the format like for deflateInit2,
+// 15 for zlib and 31 for gzip.
+static std::string compress(std::string const &data, int level, int windowBits, int strategy) {
+	z_stream z = {};
+	if (deflateInit2(&z, level, Z_DEFLATED, windowBits, 9, strategy) != Z_OK) return "";
+	std::string out(deflateBound(&z, data.size()), '\0');
+	z.next_in = (Bytef *)data.data();
+	z.avail_in = data.size();
+	z.next_out = (Bytef *)&out[0];
+	z.avail_out = out.size();
+	int const result = deflate(&z, Z_FINISH);
+	out.resize(z.total_out);
+	deflateEnd(&z);
+	return result == Z_STREAM_END ? out : "";
+}
+
+// Data with matches at all distances up to the window size.
+static std::string randomRepetitive(std::mt19937 &random, size_t size) {
+	std::string out;
+	while (out.size() < size) {
+		if (out.size() < 300 || random() % 3 == 0) {
+			// Mostly letters, so there is something for the Huffman codes to do
+			out += (char)(random() % 4 ? 'a' + random() % 16 : random() % 256);
+			continue;
+		}
+		size_t const distance = 1 + random() % std::min<size_t>(out.size(), INFLATE_WINDOW_SIZE);
+		size_t const length = 3 + random() % 256;
+		for (size_t i = 0; i < length; i++) out += out[out.size() - distance];
+	}
+	out.resize(size);
+	return out;
+}
+
+static bool checkInflateAgainstZlib(Document const &document, std::mt19937 &random) {
+	struct {
+		const char *name;
+		int strategy;
+	} const strategies[] = {
+		{"default", Z_DEFAULT_STRATEGY},
+		{"filtered", Z_FILTERED},
+		{"huffman", Z_HUFFMAN_ONLY},
+		{"rle", Z_RLE},
+		{"fixed", Z_FIXED},
+	};
+	// Several times the window is plenty, and a lot faster on the big ones.
+	std::string const data = document.data.substr(0, 8 * INFLATE_WINDOW_SIZE);
+	bool ok = true;
+	for (int level = 0; level <= 9; level += 3) {
+		for (auto const &strategy : strategies) {
+			for (InflateFormat format : {INFLATE_ZLIB, INFLATE_GZIP}) {
+				std::string const stream = compress(data, level, format == INFLATE_GZIP ? 31 : 15,
+						strategy.strategy);
+				std::string const name = document.name + " " + (format == INFLATE_GZIP ? "gzip" : "zlib")
+						+ " level " + std::to_string(level) + " " + strategy.name;
+				ok = checkInflate(name, stream, format, data, random) && ok;
+			}
+		}
+	}
+	return ok;
+}
+
+// Deflate bits, least significant first. Huffman codes go in most significant
+// bit first.
+struct BitWriter {
+	std::string out;
+	uint32_t bits = 0;
+	int count = 0;
+
+	void put(uint32_t value, int length) {
+		for (int i = 0; i < length; i++) {
+			bits |= ((value >> i) & 1) << count;
+			if (++count == 8) {
+				out += (char)bits;
+				bits = 0;
+				count = 0;
+			}
+		}
+	}
+	void code(uint32_t value, int length) {
+		for (int i = length - 1; i >= 0; i--) put(value >> i, 1);
+	}
+	void align() {
+		if (count > 0) put(0, 8 - count);
+	}
+};
+
+// The canonical Huffman codes for lengths, RFC 1951, section 3.2.2.
+static std::vector<uint32_t> canonicalCodes(std::vector<uint8_t> const &lengths) {
+	uint32_t counts[16] = {};
+	for (uint8_t length : lengths) counts[length]++;
+	counts[0] = 0;
+	uint32_t next[16] = {};
+	for (int length = 1, code = 0; length < 16; length++) {
+		code = (code + counts[length - 1]) << 1;
+		next[length] = code;
+	}
+	std::vector<uint32_t> codes(lengths.size());
+	for (size_t i = 0; i < lengths.size(); i++) {
+		if (lengths[i]) codes[i] = next[lengths[i]]++;
+	}
+	return codes;
+}
+
+// A zlib stream whose distance codes 28 and 29 are 13 bits long, which with
+// their 13 extra bits is more than the 25 bits inflate is sure to have in
+// its bit buffer. zlib never sends codes like that for data like this, so it
+// is put together by hand: one dynamic block of random literals and then
+// matches of 258 bytes from 16 KiB and more back.
+static std::string longDistanceCodes(std::string *expected) {
+	std::vector<uint8_t> literalLengths(286, 0);
+	for (int i = 0; i < 254; i++) literalLengths[i] = 8;
+	literalLengths[254] = literalLengths[255] = literalLengths[256] = literalLengths[285] = 9;
+	std::vector<uint8_t> distanceLengths(30, 0);
+	for (int i = 0; i < 12; i++) distanceLengths[i] = i + 1;
+	distanceLengths[28] = distanceLengths[29] = 13;
+	std::vector<uint32_t> const literalCodes = canonicalCodes(literalLengths);
+	std::vector<uint32_t> const distanceCodes = canonicalCodes(distanceLengths);
+
+	BitWriter writer;
+	writer.put(0x78, 8);
+	writer.put(0x01, 8);
+	// Last block, dynamic codes
+	writer.put(1, 1);
+	writer.put(2, 2);
+	writer.put(286 - 257, 5);
+	writer.put(30 - 1, 5);
+	writer.put(19 - 4, 4);
+	// Code lengths 0 to 15 all get 4 bit codes, which makes code length n
+	// simply n. The repeat codes 16 to 18 aren't used.
+	static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+	for (uint8_t symbol : order) writer.put(symbol < 16 ? 4 : 0, 3);
+	for (uint8_t length : literalLengths) writer.code(length, 4);
+	for (uint8_t length : distanceLengths) writer.code(length, 4);
+
+	std::mt19937 random(19);
+	expected->clear();
+	while (expected->size() < 24600) {
+		uint8_t const literal = random() % 254;
+		writer.code(literalCodes[literal], 8);
+		*expected += (char)literal;
+	}
+	for (int i = 0; i < 36; i++) {
+		uint16_t const symbol = i % 2 ? 29 : 28;
+		uint16_t const base = symbol == 28 ? 16385 : 24577;
+		uint16_t const extra = std::min<size_t>(random() % 8192, expected->size() - base);
+		writer.code(literalCodes[285], 9);
+		writer.code(distanceCodes[symbol], 13);
+		writer.put(extra, 13);
+		size_t const from = expected->size() - (base + extra);
+		for (int j = 0; j < 258; j++) *expected += (*expected)[from + j];
+	}
+	writer.code(literalCodes[256], 9);
+	writer.align();
+
+	uint32_t const adler = adler32(1, (const Bytef *)expected->data(), expected->size());
+	writer.put(adler >> 24, 8);
+	writer.put(adler >> 16, 8);
+	writer.put(adler >> 8, 8);
+	writer.put(adler, 8);
+	return writer.out;
+}
+
+static bool checkLongDistanceCodes(std::mt19937 &random) {
+	std::string expected;
+	std::string const stream = longDistanceCodes(&expected);
+
+	// Make sure it is what it is meant to be
+	std::string inflated(expected.size(), '\0');
+	uLongf size = inflated.size();
+	if (uncompress((Bytef *)&inflated[0], &size, (const Bytef *)stream.data(), stream.size()) != Z_OK
+			|| inflated != expected) {
+		fprintf(stderr, "inflate long distance codes: zlib doesn't take the stream\n");
+		return false;
+	}
+	return checkInflate("long distance codes", stream, INFLATE_ZLIB, expected, random);
+}
+
+// HttpBody -------------------------------------------------------------------
+
+// A connection that has received a random part of what it is going to get.
+// More arrives whenever someone asks what is available.
+class Trickle : public Stream {
+public:
+	Trickle(std::string const &data, std::mt19937 &random) : data(data), random(random) {}
+
+	int available() override {
+		if (arrived < data.size() && random() % 3 != 0) {
+			arrived = std::min<size_t>(arrived + random() % 40, data.size());
+		}
+		return arrived - at;
+	}
+	int read() override { return at < arrived ? (unsigned char)data[at++] : -1; }
+	int peek() override { return at < arrived ? (unsigned char)data[at] : -1; }
+	size_t readBytes(char *buffer, size_t length) override {
+		length = std::min(length, arrived - at);
+		memcpy(buffer, data.data() + at, length);
+		at += length;
+		return length;
+	}
+	size_t write(uint8_t) override { return 0; }
+
+	std::string const &data;
+	std::mt19937 &random;
+	size_t arrived = 0;
+	size_t at = 0;
+};
+
+// Frames payload in random chunks, with extensions and trailer fields now
+// and then.
+static std::string chunked(std::string const &payload, std::mt19937 &random) {
+	std::string out;
+	char line[32];
+	for (size_t at = 0; at < payload.size(); ) {
+		size_t const size = std::min<size_t>(1 + random() % 700, payload.size() - at);
+		snprintf(line, sizeof(line), random() % 2 ? "%zx" : "%zX", size);
+		out += line;
+		if (random() % 5 == 0) out += ";name=value";
+		out += "\r\n";
+		out.append(payload, at, size);
+		out += "\r\n";
+		at += size;
+	}
+	out += "0\r\n";
+	if (random() % 3 == 0) out += "Expires: never\r\n";
+	out += "\r\n";
+	return out;
+}
+
+// Reads body until nothing more comes, mixing all the ways there are to read.
+static std::string drain(HttpBody &body, Trickle &connection) {
+	std::string out;
+	int idle = 0;
+	while (!body.done() && !body.failed() && idle < 1000) {
+		if (body.available() <= 0) {
+			idle++;
+			continue;
+		}
+		idle = 0;
+		switch (connection.random() % 3) {
+		case 0: {
+			int const c = body.read();
+			if (c >= 0) out += (char)c;
+			break;
+		}
+		case 1: {
+			int const peeked = body.peek();
+			int const c = body.read();
+			if (c != peeked) return out + "<peek differs>";
+			if (c >= 0) out += (char)c;
+			break;
+		}
+		default: {
+			char buffer[128];
+			size_t const n = body.readBytes(buffer, 1 + connection.random() % sizeof(buffer));
+			out.append(buffer, n);
+			break;
+		}
+		}
+	}
+	return out;
+}
+
+static bool checkHttpBody(Document const &document, std::mt19937 &random) {
+	// What comes after the body on a kept connection, which must stay unread.
+	static const std::string next = "HTTP/1.1 200 OK\r\n";
+	bool ok = true;
+	for (int i = 0; i < CHUNKINGS; i++) {
+		bool const chunking = i % 2 == 0;
+		std::string const wire = (chunking ? chunked(document.data, random) : document.data) + next;
+		Trickle connection(wire, random);
+		HttpBody body;
+		body.begin(connection, chunking, chunking ? -1 : (int)document.data.size());
+		std::string const got = drain(body, connection);
+		if (got != document.data || !body.done() || connection.at != wire.size() - next.size()) {
+			fprintf(stderr, "http %s: %s body differs at byte %zu, done %d, %zu bytes left unread\n",
+					document.name.c_str(), chunking ? "chunked" : "sized", firstDifference(got, document.data),
+					body.done(), wire.size() - connection.at);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	uint32_t const seed = argc > 1 ? strtoul(argv[1], nullptr, 0) : 1;
+	std::vector<Document> corpus;
+	if (argc < 3) {
+		loadDirectory("bench/corpus", corpus);
+	}
+	for (int i = 2; i < argc; i++) {
+		DIR *dir = opendir(argv[i]);
+		if (dir) {
+			closedir(dir);
+			loadDirectory(argv[i], corpus);
+		} else if (!load(argv[i], corpus)) {
+			fprintf(stderr, "Could not read %s\n", argv[i]);
+		}
+	}
+	if (corpus.empty()) {
+		fprintf(stderr, "No corpus found. Run python bench/corpus.py first.\n");
+		return 1;
+	}
+
+	std::mt19937 random(seed);
+	bool ok = true;
+	for (Document const &document : corpus) {
+		bool const stopsOk = checkStops(document, random);
+		report("stops", document.name, stopsOk);
+		bool const kernelsOk = checkKernels(document, random());
+		report("kernels", document.name, kernelsOk);
+		bool const pathsOk = checkPaths(document, stopsSelectors, random);
+		report("paths", document.name, pathsOk);
+		bool const httpOk = checkHttpBody(document, random);
+		report("http", document.name, httpOk);
+		bool const inflateOk = checkInflateAgainstZlib(document, random);
+		report("inflate", document.name, inflateOk);
+		ok = ok && stopsOk && kernelsOk && pathsOk && httpOk && inflateOk;
+	}
+
+	int failures = 0;
+	for (int i = 0; i < RANDOM_DOCUMENTS; i++) {
+		Document const document = randomDocument(random, i);
+		if (!checkKernels(document, random())) failures++;
+	}
+	report("kernels", std::to_string(RANDOM_DOCUMENTS) + " random documents", failures == 0);
+	ok = ok && failures == 0;
+
+	failures = 0;
+	for (int i = 0; i < RANDOM_PATHS_DOCUMENTS; i++) {
+		Document const document = randomPathsDocument(random, i);
+		for (PathSelectors const &selectors : pathSelectorSets) {
+			if (!checkPaths(document, selectors, random)) failures++;
+		}
+	}
+	report("paths", std::to_string(RANDOM_PATHS_DOCUMENTS) + " random documents", failures == 0);
+	// The member with the same hash as the selected one must not get through.
+	std::string const colliding = pushPaths("{\"costarring\":\"WRONG\",\"liquid\":\"RIGHT\"}",
+			pathSelectorSets[0], random);
+	bool const collidingOk = colliding == "3 " + std::to_string((int)JIMP_EVENT_STRING) + " RIGHT\nstatus "
+			+ std::to_string((int)JIMP_PUSH_DONE) + "\n";
+	report("paths", "colliding names", collidingOk);
+	ok = ok && failures == 0 && collidingOk;
+
+	failures = 0;
+	for (int i = 0; i < RANDOM_STREAMS; i++) {
+		Document const document{"random-" + std::to_string(i), randomRepetitive(random, random() % 200'000)};
+		if (!checkInflateAgainstZlib(document, random)) failures++;
+	}
+	report("inflate", std::to_string(RANDOM_STREAMS) + " random streams", failures == 0);
+	bool const longDistanceOk = checkLongDistanceCodes(random);
+	report("inflate", "long distance codes", longDistanceOk);
+	ok = ok && failures == 0 && longDistanceOk;
+
+	printf("%s (seed %lu)\n", ok ? "All checks passed" : "Some checks FAILED", (unsigned long)seed);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+// Shared between the parts of bench/check.cpp. Doesn't include jimp.h, see
+// bench/check_scan.cpp.
+
+#ifndef BENCH_CHECK_H
+#define BENCH_CHECK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+struct Document {
+	std::string name;
+	std::string data;
+};
+
+// Where a and b part, for the error messages.
+size_t firstDifference(std::string const &a, std::string const &b);
+
+// Whether every JIMP_SCAN kernel reads document the same, see check_scan.cpp.
+bool checkKernels(Document const &document, uint32_t seed);
+
+#endif // BENCH_CHECK_H
@@ -0,0 +1,131 @@
+// What bench/check_scan.cpp runs with every kernel. Included once per kernel
+// into its namespace, right after jimp.h, so there is no include guard.
+
+// Walks the value ahead in pull mode. Some members and elements are
+// skipped, which is where the kernels do most of their work.
+static bool walk(Jimp *jimp, std::string &out) {
+	if (jimp_is_object_ahead(jimp)) {
+		if (!jimp_object_begin(jimp)) return false;
+		out += '{';
+		while (jimp_object_member(jimp)) {
+			out += '"';
+			out.append(jimp->string, jimp->string_count);
+			out += jimp->truncated ? "\"~:" : "\":";
+			if (jimp->hash % 3 == 0) {
+				out += "skipped,";
+				if (!jimp_skip_any(jimp)) return false;
+				continue;
+			}
+			if (!walk(jimp, out)) return false;
+			out += ',';
+		}
+		out += '}';
+		return jimp_object_end(jimp);
+	}
+	if (jimp_is_array_ahead(jimp)) {
+		if (!jimp_array_begin(jimp)) return false;
+		out += '[';
+		for (int i = 0; jimp_array_item(jimp); i++) {
+			if (i % 4 == 3) {
+				out += "skipped,";
+				if (!jimp_skip_any(jimp)) return false;
+				continue;
+			}
+			if (!walk(jimp, out)) return false;
+			out += ',';
+		}
+		out += ']';
+		return jimp_array_end(jimp);
+	}
+	if (jimp_is_string_ahead(jimp)) {
+		if (!jimp_string(jimp)) return false;
+		out += '"';
+		out.append(jimp->string, jimp->string_count);
+		out += jimp->truncated ? "\"~" : "\"";
+		return true;
+	}
+	if (jimp_is_number_ahead(jimp)) {
+		if (!jimp_number(jimp)) return false;
+		char number[32];
+		snprintf(number, sizeof(number), "%.17g", jimp->number);
+		out += number;
+		return true;
+	}
+	if (jimp_is_bool_ahead(jimp)) {
+		if (!jimp_bool(jimp)) return false;
+		out += jimp->boolean ? "true" : "false";
+		return true;
+	}
+	out += "null";
+	return jimp_skip_any(jimp);
+}
+
+// Small, so that long strings get truncated too.
+static char arena[64];
+
+static std::string pull(Jimp *jimp) {
+	std::string out;
+	jimp_arena(jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+	if (!walk(jimp, out)) out += " failed";
+	return out;
+}
+
+static std::string pullMemory(std::string const &document) {
+	Jimp jimp = {};
+	jimp_begin_memory(&jimp, document.data(), document.size());
+	return pull(&jimp);
+}
+
+static std::string pullFile(int fd) {
+	Jimp jimp = {};
+	lseek(fd, 0, SEEK_SET);
+	jimp_begin_fd(&jimp, fd);
+	return pull(&jimp);
+}
+
+static Jimp_Action record(Jimp *jimp, Jimp_Event event) {
+	std::string &out = *static_cast<std::string *>(jimp->user_data);
+	char line[48];
+	snprintf(line, sizeof(line), "%d@%d:", (int)event, (int)jimp->push.depth);
+	out += line;
+	switch (event) {
+	case JIMP_EVENT_MEMBER:
+	case JIMP_EVENT_STRING:
+		out.append(jimp->string, jimp->string_count);
+		if (jimp->truncated) out += '~';
+		if (event == JIMP_EVENT_MEMBER && jimp->hash % 3 == 0) {
+			out += " skipped\n";
+			return JIMP_SKIP;
+		}
+		break;
+	case JIMP_EVENT_NUMBER:
+		snprintf(line, sizeof(line), "%.17g", jimp->number);
+		out += line;
+		break;
+	case JIMP_EVENT_BOOL:
+		out += jimp->boolean ? "true" : "false";
+		break;
+	default:
+		break;
+	}
+	out += '\n';
+	return JIMP_CONTINUE;
+}
+
+static std::string push(std::string const &document, uint32_t seed) {
+	std::string out;
+	std::mt19937 random(seed);
+	Jimp jimp = {};
+	jimp_arena(&jimp, arena, sizeof(arena), JIMP_OVERFLOW_TRUNCATE);
+	jimp_push_begin(&jimp, record, &out);
+	Jimp_Push_Status status = JIMP_PUSH_MORE;
+	for (size_t at = 0; at < document.size() && status == JIMP_PUSH_MORE; ) {
+		size_t size = std::min<size_t>(random() % 300 + 1, document.size() - at);
+		status = jimp_push_feed(&jimp, document.data() + at, size);
+		at += size;
+	}
+	if (status == JIMP_PUSH_MORE) status = jimp_push_end(&jimp);
+	out += "status " + std::to_string((int)status) + "\n";
+	return out;
+}
+
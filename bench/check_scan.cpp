@@ -0,0 +1,123 @@
+// Part of bench/check.cpp: every JIMP_SCAN kernel the host can run, side by
+// side in one program. jimp.h is included once per kernel, each time into a
+// namespace of its own with JIMP_SCAN set to that kernel. Everything it
+// includes itself is included up front, so that only jimp lands in the
+// namespaces. Every kernel reads the same documents in pull mode from memory
+// and from a file, which gets refilled in pieces, and in push mode in random
+// chunks, and writes down what it saw. All of that has to come out the same.
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "arduino_compat.h"
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "check.h"
+
+#define JIMP_IMPLEMENTATION
+
+namespace scan_scalar {
+#undef JIMP_H_
+#undef JIMP_SCAN
+#define JIMP_SCAN 0
+#include "jimp.h"
+#include "check_kernel.h"
+}
+
+namespace scan_swar {
+#undef JIMP_H_
+#undef JIMP_SCAN
+#define JIMP_SCAN 1
+#include "jimp.h"
+#include "check_kernel.h"
+}
+
+#if defined(__SSE2__)
+namespace scan_sse2 {
+#undef JIMP_H_
+#undef JIMP_SCAN
+#define JIMP_SCAN 2
+#include "jimp.h"
+#include "check_kernel.h"
+}
+#endif
+
+#if defined(__AVX2__)
+namespace scan_avx2 {
+#undef JIMP_H_
+#undef JIMP_SCAN
+#define JIMP_SCAN 3
+#include "jimp.h"
+#include "check_kernel.h"
+}
+#endif
+
+struct Kernel {
+	const char *name;
+	std::string (*pullMemory)(std::string const &document);
+	std::string (*pullFile)(int fd);
+	std::string (*push)(std::string const &document, uint32_t seed);
+};
+
+static const Kernel kernels[] = {
+	{"scalar", scan_scalar::pullMemory, scan_scalar::pullFile, scan_scalar::push},
+	{"swar", scan_swar::pullMemory, scan_swar::pullFile, scan_swar::push},
+#if defined(__SSE2__)
+	{"sse2", scan_sse2::pullMemory, scan_sse2::pullFile, scan_sse2::push},
+#endif
+#if defined(__AVX2__)
+	{"avx2", scan_avx2::pullMemory, scan_avx2::pullFile, scan_avx2::push},
+#endif
+};
+
+bool checkKernels(Document const &document, uint32_t seed) {
+	FILE *file = tmpfile();
+	if (!file || fwrite(document.data.data(), 1, document.data.size(), file) != document.data.size()
+			|| fflush(file) != 0) {
+		fprintf(stderr, "kernels %s: can't write a temporary file\n", document.name.c_str());
+		if (file) fclose(file);
+		return false;
+	}
+
+	std::string const pulled = kernels[0].pullMemory(document.data);
+	std::string const pushed = kernels[0].push(document.data, seed);
+	bool ok = true;
+	for (Kernel const &kernel : kernels) {
+		struct {
+			const char *how;
+			std::string got;
+			std::string const &expected;
+		} const runs[] = {
+			{"pull from memory", kernel.pullMemory(document.data), pulled},
+			{"pull from a file", kernel.pullFile(fileno(file)), pulled},
+			{"push", kernel.push(document.data, seed), pushed},
+		};
+		for (auto const &run : runs) {
+			if (run.got == run.expected) continue;
+			fprintf(stderr, "kernels %s: %s with %s differs from scalar at byte %zu\n",
+					document.name.c_str(), run.how, kernel.name, firstDifference(run.got, run.expected));
+			ok = false;
+		}
+	}
+	fclose(file);
+	return ok;
+}
@@ -0,0 +1,68 @@
+"""Compares two runs of the benchmarks.
+
+    .pio/build/native/program > before.jsonl
+    ... change something, rebuild ...
+    .pio/build/native/program > after.jsonl
+    python bench/compare.py before.jsonl after.jsonl
+
+Prints the change of the time per item for every benchmark and corpus in both
+runs. Exits with 1 if anything got slower by more than --threshold percent or
+allocates more than before.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            # The parser's diagnostics end up on stdout too.
+            if not line.startswith("{"):
+                continue
+            result = json.loads(line)
+            if "error" in result:
+                continue
+            results[(result["bench"], result["corpus"])] = result
+    return results
+
+
+def time_per_item(result):
+    return next(value for key, value in result.items() if key.startswith("ns_per_"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("before")
+    parser.add_argument("after")
+    parser.add_argument("--threshold", type=float, default=5.0, help="percent, default %(default)s")
+    args = parser.parse_args()
+
+    before = load(args.before)
+    after = load(args.after)
+    regressed = False
+
+    print(f"{'bench':<24} {'corpus':<32} {'before':>10} {'after':>10} {'change':>8}  allocs")
+    for key in sorted(before.keys() & after.keys()):
+        old, new = before[key], after[key]
+        old_time, new_time = time_per_item(old), time_per_item(new)
+        change = (new_time - old_time) / old_time * 100
+        allocs = f"{old['allocs_per_parse']} -> {new['allocs_per_parse']}"
+        flag = ""
+        if change > args.threshold or new["allocs_per_parse"] > old["allocs_per_parse"]:
+            flag = "  <--"
+            regressed = True
+        print(f"{key[0]:<24} {key[1]:<32} {old_time:>10.1f} {new_time:>10.1f} {change:>+7.1f}%  {allocs}{flag}")
+
+    for key in sorted(before.keys() - after.keys()):
+        print(f"{key[0]:<24} {key[1]:<32} only in {args.before}")
+    for key in sorted(after.keys() - before.keys()):
+        print(f"{key[0]:<24} {key[1]:<32} only in {args.after}")
+
+    sys.exit(1 if regressed else 0)
+
+
+if __name__ == "__main__":
+    main()
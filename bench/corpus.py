@@ -0,0 +1,122 @@
+"""Writes synthetic departure monitor responses for the benchmarks.
+
+The responses have the shape and the member order of what XML_DM_REQUEST
+returns with outputFormat=rapidJSON: stop events with location, times,
+transportation and properties, and the serverInfo, locations and
+systemMessages around them. Platforms, lines and times are random but
+deterministic, so results stay comparable between runs.
+
+Captured responses can be dropped into bench/corpus/ as *.json next to these
+and are benchmarked the same way.
+
+    python bench/corpus.py [events ...]
+"""
+
+import json
+import random
+import sys
+from pathlib import Path
+
+SIZES = [10, 40, 400, 4000]
+CORPUS = Path(__file__).parent / "corpus"
+
+
+def stop_event(r, i):
+    platform = r.choice("abcdefgh")
+    line = r.choice([1, 2, 3, 4, 6, 21, 22, 23, 32, 35])
+    planned = f"2025-01-10T{12 + i // 60 % 12:02d}:{i % 60:02d}:00Z"
+
+    location = {
+        "id": f"de:09761:101:1:{platform}",
+        "isGlobalId": True,
+        "name": "Augsburg, Königsplatz",
+        "disassembledName": f"Bstg. {platform}",
+        "type": "platform",
+        "pointType": "Bussteig",
+        "coord": [5361234.0 + i, 4412345.5],
+        "properties": {
+            "stopId": "2000101",
+            "area": "1",
+            "platform": platform,
+            "platformName": platform,
+        },
+        "parent": {
+            "id": "de:09761:101",
+            "isGlobalId": True,
+            "name": "Augsburg, Königsplatz",
+            "type": "stop",
+            "parent": {"id": "placeID:9761000:1", "name": "Augsburg", "type": "locality"},
+            "properties": {"stopId": "2000101"},
+        },
+    }
+    transportation = {
+        "id": f"avg:0300{line}: :R:j25",
+        "name": f"Straßenbahn {line}",
+        "disassembledName": str(line),
+        "number": str(line),
+        "description": "Haunstetten West - Königsplatz - \"Stadtbergen\"",
+        "product": {"id": 0, "class": 4, "name": "Straßenbahn", "iconId": 4},
+        "operator": {"code": "01", "id": "01", "name": "Stadtwerke Augsburg Verkehrs-GmbH"},
+        "destination": {
+            "id": "2000500",
+            "name": "Stadtbergen",
+            "type": "stop",
+            "properties": {"stopId": "2000500"},
+        },
+        "properties": {"trainName": "", "tripCode": 123 + i, "lineDisplay": "LINE"},
+        "origin": {"id": "2000400", "name": "Haunstetten West", "type": "stop"},
+    }
+
+    event = {
+        "realtimeStatus": ["MONITORED"],
+        "isRealtimeControlled": True,
+        "location": location,
+        "departureTimePlanned": planned,
+        "departureTimeBaseTimetable": planned,
+    }
+    if i % 3:
+        event["departureTimeEstimated"] = planned.replace(":00Z", ":30Z")
+    event["transportation"] = transportation
+    event["properties"] = {"AVMSTripID": f"{i}-12345", "realtimeTripId": "x"}
+    return event
+
+
+def response(events):
+    r = random.Random(events)
+    return {
+        "version": "10.6.14.22",
+        "systemMessages": [],
+        "serverInfo": {
+            "controllerVersion": "10.6.14.22",
+            "serverID": "efa10-p",
+            "virtDir": "efa",
+            "serverTime": "2025-01-10T13:00:01",
+            "calcTime": 123.456,
+            "logRequestId": "abc",
+        },
+        "locations": [{
+            "id": "de:09761:101",
+            "name": "Augsburg, Königsplatz",
+            "type": "stop",
+            "coord": [5361234.0, 4412345.5],
+            "assignedStops": [{"id": "2000101", "name": "Königsplatz", "modes": [4, 5, 10]}],
+        }],
+        "stopEvents": [stop_event(r, i) for i in range(events)],
+    }
+
+
+def main():
+    sizes = [int(n) for n in sys.argv[1:]] or SIZES
+    CORPUS.mkdir(exist_ok=True)
+    for events in sizes:
+        doc = response(events)
+        compact = CORPUS / f"synthetic-{events}.json"
+        compact.write_text(json.dumps(doc, ensure_ascii=False, separators=(",", ":")))
+        pretty = CORPUS / f"synthetic-{events}-pretty.json"
+        pretty.write_text(json.dumps(doc, ensure_ascii=False, indent=2))
+        print(f"{compact} {compact.stat().st_size} bytes")
+        print(f"{pretty} {pretty.stat().st_size} bytes")
+
+
+if __name__ == "__main__":
+    main()
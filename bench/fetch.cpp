@@ -0,0 +1,302 @@
+// End-to-end fetches against bench/mock_efa.py. Sends the request, reads the
+// response headers and then runs the body through HttpBody, inflate and the
+// stop parser in push mode with body_parser_run, like fetchStops does. The
+// connection is kept between fetches and opened again when the server closed
+// it. Prints one JSON object per line and fetch:
+//
+//     {"fetch":0,"result":"ok","reused":false,"status":200,"gzip":true,
+//      "chunked":true,"wire_bytes":8123,"payload_bytes":50843,"events":18,
+//      "stopped":true,"request_ms":1.2,"body_ms":25.3}
+//
+// There is no TLS on the host, so run the server with --plain:
+//
+//     python bench/mock_efa.py --plain --port 8080 --gzip --chunked --rate 20000 &
+//     pio run -e native_fetch -t exec
+//     .pio/build/native_fetch/program [host [port [fetches [rows]]]]
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "body_parser.h"
+#include "http_body.h"
+#include "inflate.h"
+#include "stop_parser.h"
+
+#define JIMP_IMPLEMENTATION
+#include "jimp.h"
+
+// Same as in main.cpp
+static constexpr uint32_t STALL_TIMEOUT_MS{5'000};
+static constexpr uint32_t BODY_END_TIMEOUT_MS{200};
+static constexpr size_t JIMP_ARENA_SIZE{256};
+static constexpr size_t INFLATE_WINDOW_SIZE{32 * 1024};
+
+static const char REQUEST_PATH[] = "/efa/XML_DM_REQUEST?outputFormat=rapidJSON&type_dm=stop&name_dm=de%3A09761%3A101";
+
+static double now_ms() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+// A socket as a Stream that never blocks, like WiFiClient.
+class SocketStream : public Stream {
+public:
+	int fd = -1;
+	size_t received = 0;
+
+	int available() override {
+		int n = 0;
+		if (fd < 0 || ioctl(fd, FIONREAD, &n) < 0) return 0;
+		return n;
+	}
+	int read() override {
+		char c;
+		return readBytes(&c, 1) == 1 ? (unsigned char)c : -1;
+	}
+	int peek() override {
+		char c;
+		return recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1 ? (unsigned char)c : -1;
+	}
+	size_t readBytes(char *buffer, size_t length) override {
+		ssize_t n = recv(fd, buffer, length, MSG_DONTWAIT);
+		if (n <= 0) return 0;
+		received += n;
+		return n;
+	}
+	size_t write(uint8_t) override { return 0; }
+
+	// Waits up to timeout ms for something to read. False if there is nothing.
+	bool wait(int timeout) {
+		struct pollfd p = {fd, POLLIN, 0};
+		return poll(&p, 1, timeout) > 0;
+	}
+	// Readable without anything to read means the server closed it.
+	bool connected() {
+		return fd >= 0 && !(wait(0) && available() == 0);
+	}
+	void stop() {
+		if (fd >= 0) close(fd);
+		fd = -1;
+	}
+};
+
+static bool connect_to(SocketStream &connection, const char *host, const char *port) {
+	struct addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *addresses;
+	if (getaddrinfo(host, port, &hints, &addresses) != 0) return false;
+	for (struct addrinfo *a = addresses; a; a = a->ai_next) {
+		int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd < 0) continue;
+		if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+			int one = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			connection.fd = fd;
+			break;
+		}
+		close(fd);
+	}
+	freeaddrinfo(addresses);
+	return connection.fd >= 0;
+}
+
+struct Response {
+	int status = 0;
+	int size = -1;
+	bool chunked = false;
+	bool close = false;
+	std::string encoding;
+};
+
+static bool header_is(std::string const &line, const char *name, std::string *value) {
+	size_t n = strlen(name);
+	if (line.size() <= n || strncasecmp(line.c_str(), name, n) != 0 || line[n] != ':') return false;
+	size_t start = line.find_first_not_of(" \t", n + 1);
+	*value = start == std::string::npos ? "" : line.substr(start);
+	return true;
+}
+
+// Sends the request and reads the status line and headers.
+static bool request(SocketStream &connection, const char *host, Response *response) {
+	char request[512];
+	int length = snprintf(request, sizeof(request),
+		"GET %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\nAccept-Encoding: gzip\r\n\r\n",
+		REQUEST_PATH, host);
+	if (send(connection.fd, request, length, MSG_NOSIGNAL) != length) return false;
+
+	std::string line;
+	bool first = true;
+	while (true) {
+		if (!connection.wait(STALL_TIMEOUT_MS)) return false;
+		char c;
+		if (recv(connection.fd, &c, 1, 0) != 1) return false;
+		if (c != '\n') {
+			if (c != '\r') line += c;
+			continue;
+		}
+		if (line.empty()) return response->status != 0;
+
+		std::string value;
+		if (first) {
+			if (sscanf(line.c_str(), "HTTP/1.%*d %d", &response->status) != 1) return false;
+			first = false;
+		} else if (header_is(line, "Content-Length", &value)) {
+			response->size = atoi(value.c_str());
+		} else if (header_is(line, "Transfer-Encoding", &value)) {
+			response->chunked = strcasecmp(value.c_str(), "chunked") == 0;
+		} else if (header_is(line, "Content-Encoding", &value)) {
+			response->encoding = value;
+		} else if (header_is(line, "Connection", &value)) {
+			response->close = strcasecmp(value.c_str(), "close") == 0;
+		}
+		line.clear();
+	}
+}
+
+// Like addStop in main.cpp: a column of rows for each shown platform, and the
+// parse ends once all of them are full. Fewer rows than on the display make
+// the synthetic corpus fill them too.
+static size_t rows = 9;
+static size_t events;
+static size_t platformEvents[2];
+
+static bool show_platform(char platform) {
+	return platform == 'a' || platform == 'e';
+}
+
+static bool count_event(ParsedStopEvent const &event, DateTime const &) {
+	size_t &count = platformEvents[event.platform == 'a' ? 0 : 1];
+	if (count < rows) {
+		count++;
+		events++;
+	}
+	return platformEvents[0] < rows || platformEvents[1] < rows;
+}
+
+static bool socket_connected(void *connection) {
+	return ((SocketStream *)connection)->connected();
+}
+
+struct Inflater {
+	Inflate inflate;
+	char window[INFLATE_WINDOW_SIZE];
+};
+
+// One fetch, the way fetchStops does it. Returns what went wrong or nullptr.
+static const char *fetch(SocketStream &connection, const char *host, const char *port, int index) {
+	double started = now_ms();
+	bool reused = connection.connected();
+	if (!reused) {
+		connection.stop();
+		if (!connect_to(connection, host, port)) return "connect";
+	}
+	Response response;
+	if (!request(connection, host, &response)) {
+		if (!reused) return "request";
+		// The kept connection went stale
+		connection.stop();
+		reused = false;
+		if (!connect_to(connection, host, port)) return "connect";
+		response = Response();
+		if (!request(connection, host, &response)) return "request";
+	}
+	double requestMs = now_ms() - started;
+	if (response.status != 200) return "status";
+
+	HttpBody body;
+	body.begin(connection, response.chunked, response.size);
+	connection.received = 0;
+
+	DateTime serverLocalTime;
+	DateTime nowUtc;
+	StopParserUserData userData{serverLocalTime, nowUtc, count_event, show_platform};
+	char jimpArena[JIMP_ARENA_SIZE];
+	Jimp jimp = {};
+	jimp_arena(&jimp, jimpArena, sizeof(jimpArena), JIMP_OVERFLOW_TRUNCATE);
+	StopPushParser parser;
+	parse_stops_push_begin(&jimp, &parser, &userData);
+	events = 0;
+	memset(platformEvents, 0, sizeof(platformEvents));
+
+	bool compressed = response.encoding == "gzip" || response.encoding == "deflate";
+	std::unique_ptr<Inflater> inflater;
+	if (compressed) {
+		inflater.reset(new Inflater);
+		inflate_begin(&inflater->inflate, response.encoding == "gzip" ? INFLATE_GZIP : INFLATE_ZLIB,
+			inflater->window, sizeof(inflater->window), body_parser_sink, &jimp);
+	} else if (!response.encoding.empty() && response.encoding != "identity") {
+		connection.stop();
+		return "encoding";
+	}
+
+	BodyParser bodyParser = {
+		.jimp = &jimp,
+		.body = &body,
+		.inflate = compressed ? &inflater->inflate : nullptr,
+		.connected = socket_connected,
+		.userData = &connection,
+	};
+	double bodyStarted = now_ms();
+	const char *error = nullptr;
+	switch (body_parser_run(&bodyParser, STALL_TIMEOUT_MS)) {
+	case BODY_PARSED:
+		break;
+	case BODY_INVALID_CHUNKING:
+		error = "chunking";
+		break;
+	case BODY_INVALID_COMPRESSION:
+		error = "inflate";
+		break;
+	case BODY_INVALID_JSON:
+		error = "parse";
+		break;
+	case BODY_STALLED:
+		error = "stall";
+		break;
+	}
+	double bodyMs = now_ms() - bodyStarted;
+	size_t payload = compressed ? inflater->inflate.total : bodyParser.bytes;
+
+	// Leave the connection ready for the next request, or drop it. Also when
+	// the parse stopped early, like fetchStops.
+	if (error || !body_parser_finish(&bodyParser, BODY_END_TIMEOUT_MS) || response.close) connection.stop();
+
+	printf("{\"fetch\":%d,\"result\":\"%s\",\"reused\":%s,\"status\":%d,\"gzip\":%s,\"chunked\":%s,"
+		"\"wire_bytes\":%zu,\"payload_bytes\":%zu,\"events\":%zu,\"stopped\":%s,\"request_ms\":%.1f,\"body_ms\":%.1f}\n",
+		index, error ? error : "ok", reused ? "true" : "false", response.status,
+		compressed ? "true" : "false", response.chunked ? "true" : "false",
+		connection.received, payload, events, jimp.stopped ? "true" : "false", requestMs, bodyMs);
+	return error;
+}
+
+int main(int argc, char **argv) {
+	const char *host = argc > 1 ? argv[1] : "localhost";
+	const char *port = argc > 2 ? argv[2] : "8080";
+	int fetches = argc > 3 ? atoi(argv[3]) : 10;
+	if (argc > 4) rows = strtoul(argv[4], nullptr, 10);
+
+	SocketStream connection;
+	int failed = 0;
+	for (int i = 0; i < fetches; i++) {
+		if (fetch(connection, host, port, i)) failed++;
+		fflush(stdout);
+	}
+	connection.stop();
+	return failed > 0;
+}
@@ -0,0 +1,253 @@
+"""Stand-in for the EFA server, for reproducible fetches.
+
+Replays the responses in bench/corpus/ (see bench/corpus.py) over HTTPS, one
+after the other, to every request. With --record, requests are passed on to
+the real server and its responses are saved into the corpus before they are
+replayed.
+
+    python bench/mock_efa.py [--port 8443] [--record] [faults ...]
+
+On top of that it can make the responses worse in the ways the real server
+and network do:
+
+    --rate 2000             send at most 2000 bytes per second
+    --chunked               use chunked transfer coding with random chunk sizes
+    --gzip                  compress if the client accepts it
+    --stall-after 10000     stop sending for --stall-for seconds after 10000
+                            bytes of the body
+    --truncate-at 10000     close the connection after 10000 bytes of the body
+    --close                 close the connection after every response
+    --variation unknown     change the schema, see VARIATIONS
+
+Point the firmware at it with EFA_HOST and EFA_PORT in secrets.h, or use
+bench/fetch.cpp on the same machine together with --plain. The certificate
+is self-signed and generated with openssl into bench/mock-cert/ unless
+--cert and --key are given. The firmware only checks the certificate of
+the real server.
+"""
+
+import argparse
+import gzip
+import http.server
+import json
+import random
+import socket
+import socketserver
+import ssl
+import subprocess
+import sys
+import time
+import urllib.request
+from datetime import datetime
+from pathlib import Path
+
+BENCH = Path(__file__).parent
+UPSTREAM = "https://fahrtauskunft.avv-augsburg.de"
+
+
+def add_unknown(value):
+    """Members the parser has never seen, at every level."""
+    if isinstance(value, dict):
+        value = {k: add_unknown(v) for k, v in value.items()}
+        value["mockExtension"] = {"list": [1, "two", None], "nested": {"flag": True}}
+    elif isinstance(value, list):
+        value = [add_unknown(v) for v in value]
+    return value
+
+
+def reorder(value, r=random.Random(0)):
+    """Same members, different order."""
+    if isinstance(value, dict):
+        items = list(value.items())
+        r.shuffle(items)
+        return {k: reorder(v) for k, v in items}
+    if isinstance(value, list):
+        return [reorder(v) for v in value]
+    return value
+
+
+def no_realtime(value):
+    """No estimated departures, like at night or when the feed is down."""
+    for event in value.get("stopEvents", []):
+        event.pop("departureTimeEstimated", None)
+    return value
+
+
+def nulls(value):
+    """Optional members that are there, but null."""
+    for event in value.get("stopEvents", []):
+        for key in ("departureTimeEstimated", "transportation"):
+            if key in event:
+                event[key] = None
+    return value
+
+
+def long_strings(value):
+    """Strings longer than the parser's arena."""
+    for event in value.get("stopEvents", []):
+        event.setdefault("infos", []).append({"content": "Umleitung " * 200})
+    return value
+
+
+VARIATIONS = {
+    "unknown": add_unknown,
+    "reorder": reorder,
+    "no-realtime": no_realtime,
+    "nulls": nulls,
+    "long-strings": long_strings,
+}
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    # Keep-alive, like the real server
+    protocol_version = "HTTP/1.1"
+
+    def setup(self):
+        super().setup()
+        # Small writes go out when they are made, not when the client ACKs.
+        self.connection.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    def do_GET(self):
+        options = self.server.options
+        if not self.path.startswith("/efa/XML_DM_REQUEST"):
+            self.send_error(404)
+            return
+
+        if options.record:
+            body = self.record()
+        else:
+            body = self.server.next_response()
+        if options.variation:
+            body = json.dumps(VARIATIONS[options.variation](json.loads(body)),
+                              ensure_ascii=False, separators=(",", ":")).encode()
+
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json; charset=UTF-8")
+        if options.gzip and "gzip" in self.headers.get("Accept-Encoding", ""):
+            body = gzip.compress(body)
+            self.send_header("Content-Encoding", "gzip")
+        if options.chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+        if options.close:
+            self.send_header("Connection", "close")
+            self.close_connection = True
+        self.end_headers()
+
+        self.send_body(body)
+        self.log_message("sent %d bytes", len(body))
+
+    def record(self):
+        request = urllib.request.Request(UPSTREAM + self.path, headers={"User-Agent": "mock_efa"})
+        with urllib.request.urlopen(request) as response:
+            body = response.read()
+        path = self.server.corpus / f"recorded-{datetime.now():%Y%m%d-%H%M%S}.json"
+        path.write_bytes(body)
+        self.log_message("recorded %s", path)
+        return body
+
+    def send_body(self, body):
+        options = self.server.options
+        r = random.Random()
+        sent = 0
+        stalled = False
+        while sent < len(body):
+            n = r.randint(1, 4096) if options.chunked else 1024
+            if options.rate:
+                n = min(n, max(1, options.rate // 10))
+            if options.stall_after is not None and not stalled and sent + n > options.stall_after:
+                n = max(0, options.stall_after - sent)
+            if options.truncate_at is not None and sent + n > options.truncate_at:
+                n = max(0, options.truncate_at - sent)
+
+            if n > 0:
+                piece = body[sent:sent + n]
+                if options.chunked:
+                    piece = b"%x\r\n%s\r\n" % (len(piece), piece)
+                self.wfile.write(piece)
+                self.wfile.flush()
+                sent += n
+                if options.rate:
+                    time.sleep(n / options.rate)
+
+            if options.truncate_at is not None and sent >= options.truncate_at:
+                self.log_message("truncated after %d bytes", sent)
+                self.close_connection = True
+                return
+            if options.stall_after is not None and not stalled and sent >= options.stall_after:
+                self.log_message("stalling for %g s", options.stall_for)
+                self.wfile.flush()
+                time.sleep(options.stall_for)
+                stalled = True
+
+        if options.chunked:
+            self.wfile.write(b"0\r\n\r\n")
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+
+    def __init__(self, address, options):
+        super().__init__(address, Handler)
+        self.options = options
+        self.corpus = Path(options.corpus)
+        self.corpus.mkdir(exist_ok=True)
+        self.responses = sorted(self.corpus.glob("*.json"))
+        self.index = 0
+        if not self.responses and not options.record:
+            sys.exit(f"no responses in {self.corpus}, run bench/corpus.py or use --record")
+
+    def next_response(self):
+        path = self.responses[self.index % len(self.responses)]
+        self.index += 1
+        return path.read_bytes()
+
+
+def certificate(options):
+    if options.cert:
+        return options.cert, options.key
+    directory = BENCH / "mock-cert"
+    cert, key = directory / "cert.pem", directory / "key.pem"
+    if not cert.exists():
+        directory.mkdir(exist_ok=True)
+        # ECDSA, like the real server
+        subprocess.run([
+            "openssl", "req", "-x509", "-nodes", "-days", "3650",
+            "-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1",
+            "-subj", "/CN=fahrtauskunft.avv-augsburg.de",
+            "-keyout", str(key), "-out", str(cert),
+        ], check=True, capture_output=True)
+    return str(cert), str(key)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--plain", action="store_true", help="HTTP instead of HTTPS")
+    parser.add_argument("--cert")
+    parser.add_argument("--key")
+    parser.add_argument("--corpus", default=str(BENCH / "corpus"))
+    parser.add_argument("--record", action="store_true")
+    parser.add_argument("--rate", type=int, help="bytes per second")
+    parser.add_argument("--chunked", action="store_true")
+    parser.add_argument("--gzip", action="store_true")
+    parser.add_argument("--stall-after", type=int)
+    parser.add_argument("--stall-for", type=float, default=10.0)
+    parser.add_argument("--truncate-at", type=int)
+    parser.add_argument("--close", action="store_true")
+    parser.add_argument("--variation", choices=VARIATIONS)
+    options = parser.parse_args()
+
+    server = Server(("", options.port), options)
+    if not options.plain:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(*certificate(options))
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    scheme = "http" if options.plain else "https"
+    print(f"Serving {len(server.responses)} responses on {scheme}://0.0.0.0:{options.port}/efa/XML_DM_REQUEST")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,65 @@
+// Stand-ins for the few parts of the Arduino core that datetime, the parser
+// and the body loop use, so that they can be built and measured on a workstation.
+// On the device this is just Arduino.h.
+
+#ifndef ARDUINO_COMPAT_H
+#define ARDUINO_COMPAT_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define memcpy_P memcpy
+
+class __FlashStringHelper;
+typedef std::string String;
+
+// Only the reading half, and without timeouts: readBytes stops at the first
+// byte that isn't there.
+class Stream {
+public:
+    virtual ~Stream() {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual size_t readBytes(char *buffer, size_t length)
+    {
+        size_t n = 0;
+        for (int c; n < length && (c = read()) >= 0; n++) buffer[n] = (char)c;
+        return n;
+    }
+    virtual size_t write(uint8_t) = 0;
+    virtual void flush() {}
+};
+
+// Monotonic, and wrapping like on the device
+inline uint32_t micros()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+inline uint32_t millis()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+inline void delay(uint32_t ms) { usleep(ms * 1000); }
+inline void yield() {}
+
+using std::max;
+using std::min;
+#endif
+
+#endif // ARDUINO_COMPAT_H
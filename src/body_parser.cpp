@@ -0,0 +1,82 @@
+#include "body_parser.h"
+
+#include "arduino_compat.h"
+
+// Bytes read from the body at once. Compressed ones go through the window of
+// the inflater, the others are parsed right from here.
+static constexpr size_t BODY_INPUT_SIZE{256};
+
+bool body_parser_sink(const char *data, size_t size, void *jimp) {
+	return jimp_push_feed((Jimp *)jimp, data, size) == JIMP_PUSH_MORE;
+}
+
+// Reads and parses what has arrived. Returns false if it didn't inflate.
+static bool body_parser_read(BodyParser *parser) {
+	Jimp *jimp = parser->jimp;
+	char input[BODY_INPUT_SIZE];
+	size_t want = min((size_t)parser->body->available(), sizeof(input));
+#if JIMP_STATS
+	uint32_t readMicros = micros();
+#endif
+	size_t n = parser->body->readBytes(input, want);
+#if JIMP_STATS
+	jimp->stats.wait_us += micros() - readMicros;
+#endif
+	parser->bytes += n;
+
+	if (!parser->inflate) {
+		jimp_push_feed(jimp, input, n);
+		return true;
+	}
+	uint32_t startMicros = micros();
+	InflateStatus status = inflate_feed(parser->inflate, input, n);
+	parser->inflateMicros += micros() - startMicros;
+
+	switch (status) {
+	case INFLATE_MORE:
+	case INFLATE_STOPPED:
+		return true;
+	case INFLATE_DONE:
+		jimp_push_end(jimp);
+		return true;
+	case INFLATE_ERROR:
+		break;
+	}
+	return false;
+}
+
+BodyStatus body_parser_run(BodyParser *parser, uint32_t stallTimeout) {
+	Jimp *jimp = parser->jimp;
+	HttpBody &body = *parser->body;
+	uint32_t lastProgressMillis = millis();
+	while (jimp->push.status == JIMP_PUSH_MORE) {
+		if (body.available() > 0) {
+			if (!body_parser_read(parser)) {
+				return BODY_INVALID_COMPRESSION;
+			}
+			lastProgressMillis = millis();
+			yield();
+		} else if (body.failed()) {
+			return BODY_INVALID_CHUNKING;
+		} else if (body.done() || !parser->connected(parser->userData)) {
+			jimp_push_end(jimp);
+		} else if (millis() - lastProgressMillis > stallTimeout) {
+			return BODY_STALLED;
+		} else {
+			delay(1);
+		}
+	}
+	return jimp->push.status == JIMP_PUSH_DONE ? BODY_PARSED : BODY_INVALID_JSON;
+}
+
+bool body_parser_finish(BodyParser *parser, uint32_t timeout) {
+	HttpBody &body = *parser->body;
+	char rest[64];
+	uint32_t startMillis = millis();
+	while (!body.done() && parser->connected(parser->userData) && millis() - startMillis < timeout) {
+		if (body.readBytes(rest, sizeof(rest)) == 0) {
+			delay(1);
+		}
+	}
+	return body.done();
+}
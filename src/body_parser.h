@@ -0,0 +1,58 @@
+#ifndef BODY_PARSER
+#define BODY_PARSER
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "http_body.h"
+#include "inflate.h"
+#include "jimp.h"
+
+// Runs the body of a response through inflate, if it is compressed, and a push
+// mode parse as it arrives. Never waits for more than a millisecond at a time,
+// so the Wi-Fi/TLS stack gets to run in between. Shared by fetchStops and the
+// host end-to-end bench, bench/fetch.cpp.
+
+enum BodyStatus {
+	// The parse is done, or stopped early, see Jimp::stopped.
+	BODY_PARSED,
+	BODY_INVALID_CHUNKING,
+	BODY_INVALID_COMPRESSION,
+	// The body ended before the parse did, or was no valid JSON.
+	BODY_INVALID_JSON,
+	// Nothing arrived for the stall timeout.
+	BODY_STALLED,
+};
+
+struct BodyParser {
+	Jimp *jimp;
+	HttpBody *body;
+	// Inflates the body on the way if not nullptr. Its sink has to be
+	// body_parser_sink with jimp as the user data.
+	Inflate *inflate;
+	// Whether the connection is still open. A body without length and chunking
+	// ends with it.
+	bool (*connected)(void *userData);
+	void *userData;
+
+	// Bytes read from the body, compressed or not.
+	size_t bytes = 0;
+	// Time spent inflating, the parse of its output included.
+	uint32_t inflateMicros = 0;
+};
+
+// Sink for the inflater of a BodyParser. Stops once the parse is over.
+bool body_parser_sink(const char *data, size_t size, void *jimp);
+
+// Parses the body until the parse is over or nothing arrives for stallTimeout
+// ms. jimp has to be set up for the push mode parse already.
+BodyStatus body_parser_run(BodyParser *parser, uint32_t stallTimeout);
+
+// Reads what is left of the body after a parse: whitespace, the gzip trailer
+// and the end of the chunking. The next request on the connection would start
+// with it otherwise. It is usually on its way already, so this waits up to
+// timeout ms for it, which is cheaper than connecting again. Returns whether
+// the body is over, else the connection has to be dropped.
+bool body_parser_finish(BodyParser *parser, uint32_t timeout);
+
+#endif // BODY_PARSER
@@ -11,47 +11,91 @@
 /**************************************************************************/
 
 /**
-  Number of days in each month, from January to November. December is not
-  needed. Omitting it avoids an incompatibility with Paul Stoffregen's Time
-  library. C.f. https://github.com/adafruit/RTClib/issues/114
+  Number of days in each month, from January to December, outside of leap
+  years.
 */
 const uint8_t daysInMonth[] PROGMEM = {31, 28, 31, 30, 31, 30,
-                                       31, 31, 30, 31, 30};
+                                       31, 31, 30, 31, 30, 31};
+
+/**
+  Time that marks a DateTime as invalid. It is past the end of the supported
+  range, 31 Dec 2105.
+*/
+static const uint32_t INVALID_TIME = 0xFFFFFFFF;
 
 /**************************************************************************/
 /*!
-    @brief  Given a date, return number of days since 2000/01/01,
-            valid for 2000--2099
+    @brief  Given a date, return number of days since 1970/01/01,
+            valid for 1970--2105
+    @see https://howardhinnant.github.io/date_algorithms.html#days_from_civil
     @param y Year
     @param m Month
     @param d Day
     @return Number of days
 */
 /**************************************************************************/
-static uint16_t date2days(uint16_t y, uint8_t m, uint8_t d) {
-  if (y >= 2000U)
-    y -= 2000U;
-  uint16_t days = d;
-  for (uint8_t i = 1; i < m; ++i)
-    days += pgm_read_byte(daysInMonth + i - 1);
-  if (m > 2 && y % 4 == 0)
-    ++days;
-  return days + 365 * y + (y + 3) / 4 - 1;
+static uint32_t date2days(uint16_t y, uint8_t m, uint8_t d) {
+  // Count years from March, so that leap days are at the end of the year
+  y -= m <= 2;
+  uint32_t era = y / 400;
+  uint32_t yearOfEra = y - era * 400;
+  uint32_t dayOfYear = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  uint32_t dayOfEra =
+      yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Given a number of days since 1970/01/01, return the date. The
+            converse of date2days().
+    @see https://howardhinnant.github.io/date_algorithms.html#civil_from_days
+    @param days Number of days
+    @param[out] y Year
+    @param[out] m Month
+    @param[out] d Day
+*/
+/**************************************************************************/
+static void days2date(uint32_t days, uint16_t &y, uint8_t &m, uint8_t &d) {
+  days += 719468; // from 0000-03-01
+  uint32_t era = days / 146097;
+  uint32_t dayOfEra = days - era * 146097;
+  uint32_t yearOfEra =
+      (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) /
+      365;
+  uint32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 -
+                                   yearOfEra / 100);
+  uint32_t monthFromMarch = (5 * dayOfYear + 2) / 153;
+  d = dayOfYear - (153 * monthFromMarch + 2) / 5 + 1;
+  m = monthFromMarch < 10 ? monthFromMarch + 3 : monthFromMarch - 9;
+  y = era * 400 + yearOfEra + (m <= 2);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Given a number of days, hours, minutes, and seconds, return the
-   total seconds
-    @param days Days
-    @param h Hours
-    @param m Minutes
-    @param s Seconds
+    @brief  Given a date and time, return the seconds since 1970/01/01, or
+            INVALID_TIME if there is no such date and time
+    @param y Either the full year (range: 1970--2105) or the offset from
+        year 2000 (range: 0--99)
+    @param m Month
+    @param d Day
+    @param hh Hours
+    @param mm Minutes
+    @param ss Seconds
     @return Number of seconds total
 */
 /**************************************************************************/
-static uint32_t time2ulong(uint16_t days, uint8_t h, uint8_t m, uint8_t s) {
-  return ((days * 24UL + h) * 60 + m) * 60 + s;
+static uint32_t date2time(uint16_t y, uint8_t m, uint8_t d, uint8_t hh,
+                          uint8_t mm, uint8_t ss) {
+  if (y < 100)
+    y += 2000U;
+  if (y < 1970 || y > 2105 || m < 1 || m > 12 || d < 1 || hh > 23 ||
+      mm > 59 || ss > 59)
+    return INVALID_TIME;
+  bool leap = y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+  if (d > pgm_read_byte(daysInMonth + m - 1) + (m == 2 && leap))
+    return INVALID_TIME;
+  return ((date2days(y, m, d) * 24UL + hh) * 60 + mm) * 60 + ss;
 }
 
 /**************************************************************************/
@@ -74,40 +118,15 @@ static uint32_t time2ulong(uint16_t days, uint8_t h, uint8_t m, uint8_t s) {
        _not_ suffer from the
        [year 2038 problem](https://en.wikipedia.org/wiki/Year_2038_problem).
 
-    If called without argument, it returns the earliest time representable
-    by this class: 2000-01-01 00:00:00.
+    If called without argument, it returns 2000-01-01 00:00:00. The earliest
+    time representable by this class is 1970-01-01 00:00:00, at t = 0.
 
     @see The `unixtime()` method is the converse of this constructor.
 
     @param t Time elapsed in seconds since 1970-01-01 00:00:00.
 */
 /**************************************************************************/
-DateTime::DateTime(uint32_t t) {
-  t -= SECONDS_FROM_1970_TO_2000; // bring to 2000 timestamp from 1970
-
-  ss = t % 60;
-  t /= 60;
-  mm = t % 60;
-  t /= 60;
-  hh = t % 24;
-  uint16_t days = t / 24;
-  uint8_t leap;
-  for (yOff = 0;; ++yOff) {
-    leap = yOff % 4 == 0;
-    if (days < 365U + leap)
-      break;
-    days -= 365 + leap;
-  }
-  for (m = 1; m < 12; ++m) {
-    uint8_t daysPerMonth = pgm_read_byte(daysInMonth + m - 1);
-    if (leap && m == 2)
-      ++daysPerMonth;
-    if (days < daysPerMonth)
-      break;
-    days -= daysPerMonth;
-  }
-  d = days + 1;
-}
+DateTime::DateTime(uint32_t t) : _time(t) {}
 
 /**************************************************************************/
 /*!
@@ -116,7 +135,7 @@ DateTime::DateTime(uint32_t t) {
            the constructed DateTime will be invalid.
     @see   The `isValid()` method can be used to test whether the
            constructed DateTime is valid.
-    @param year Either the full year (range: 2000--2099) or the offset from
+    @param year Either the full year (range: 1970--2105) or the offset from
         year 2000 (range: 0--99).
     @param month Month number (1--12).
     @param day Day of the month (1--31).
@@ -124,16 +143,8 @@ DateTime::DateTime(uint32_t t) {
 */
 /**************************************************************************/
 DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour,
-                   uint8_t min, uint8_t sec) {
-  if (year >= 2000U)
-    year -= 2000U;
-  yOff = year;
-  m = month;
-  d = day;
-  hh = hour;
-  mm = min;
-  ss = sec;
-}
+                   uint8_t min, uint8_t sec)
+    : _time(date2time(year, month, day, hour, min, sec)) {}
 
 /**************************************************************************/
 /*!
@@ -141,9 +152,7 @@ DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour,
     @param copy DateTime to copy.
 */
 /**************************************************************************/
-DateTime::DateTime(const DateTime &copy)
-    : yOff(copy.yOff), m(copy.m), d(copy.d), hh(copy.hh), mm(copy.mm),
-      ss(copy.ss) {}
+DateTime::DateTime(const DateTime &copy) : _time(copy._time) {}
 
 /**************************************************************************/
 /*!
@@ -179,7 +188,7 @@ static uint8_t conv2d(const char *p) {
 */
 /**************************************************************************/
 DateTime::DateTime(const char *date, const char *time) {
-  yOff = conv2d(date + 9);
+  uint8_t m = 0;
   // Jan Feb Mar Apr May Jun Jul Aug Sep Oct Nov Dec
   switch (date[0]) {
   case 'J':
@@ -207,10 +216,8 @@ DateTime::DateTime(const char *date, const char *time) {
     m = 12;
     break;
   }
-  d = conv2d(date + 4);
-  hh = conv2d(time);
-  mm = conv2d(time + 3);
-  ss = conv2d(time + 6);
+  _time = date2time(conv2d(date + 9), m, conv2d(date + 4), conv2d(time),
+                    conv2d(time + 3), conv2d(time + 6));
 }
 
 /**************************************************************************/
@@ -232,7 +239,8 @@ DateTime::DateTime(const __FlashStringHelper *date,
                    const __FlashStringHelper *time) {
   char buff[11];
   memcpy_P(buff, date, 11);
-  yOff = conv2d(buff + 9);
+  uint8_t y = conv2d(buff + 9);
+  uint8_t m = 0;
   // Jan Feb Mar Apr May Jun Jul Aug Sep Oct Nov Dec
   switch (buff[0]) {
   case 'J':
@@ -260,11 +268,9 @@ DateTime::DateTime(const __FlashStringHelper *date,
     m = 12;
     break;
   }
-  d = conv2d(buff + 4);
+  uint8_t d = conv2d(buff + 4);
   memcpy_P(buff, time, 8);
-  hh = conv2d(buff);
-  mm = conv2d(buff + 3);
-  ss = conv2d(buff + 6);
+  _time = date2time(y, m, d, conv2d(buff), conv2d(buff + 3), conv2d(buff + 6));
 }
 
 /**************************************************************************/
@@ -282,7 +288,8 @@ DateTime::DateTime(const __FlashStringHelper *date,
     DateTime dt("2020-06-25T15:29:37");
     ```
 
-    @note The year must be > 2000, as only the yOff is considered.
+    @note Missing parts are taken from 2000-01-01T00:00:00, anything after
+        the seconds, like a time zone, is ignored.
 
     @param iso8601dateTime
            A dateTime string in iso8601 format,
@@ -293,12 +300,9 @@ DateTime::DateTime(const __FlashStringHelper *date,
 DateTime::DateTime(const char *iso8601dateTime) {
   char ref[] = "2000-01-01T00:00:00";
   memcpy(ref, iso8601dateTime, min(strlen(ref), strlen(iso8601dateTime)));
-  yOff = conv2d(ref + 2);
-  m = conv2d(ref + 5);
-  d = conv2d(ref + 8);
-  hh = conv2d(ref + 11);
-  mm = conv2d(ref + 14);
-  ss = conv2d(ref + 17);
+  _time = date2time(conv2d(ref) * 100 + conv2d(ref + 2), conv2d(ref + 5),
+                    conv2d(ref + 8), conv2d(ref + 11), conv2d(ref + 14),
+                    conv2d(ref + 17));
 }
 
 /**************************************************************************/
@@ -307,12 +311,57 @@ DateTime::DateTime(const char *iso8601dateTime) {
     @return true if valid, false if not.
 */
 /**************************************************************************/
-bool DateTime::isValid() const {
-  if (yOff >= 100)
-    return false;
-  DateTime other(unixtime());
-  return yOff == other.yOff && m == other.m && d == other.d && hh == other.hh &&
-         mm == other.mm && ss == other.ss;
+bool DateTime::isValid() const { return _time != INVALID_TIME; }
+
+/**************************************************************************/
+/*!
+    @brief  Compute the date, which is not stored.
+    @param[out] year Year (range: 1970--2105).
+    @param[out] month Month number (1--12).
+    @param[out] day Day of the month (1--31).
+*/
+/**************************************************************************/
+void DateTime::date(uint16_t &year, uint8_t &month, uint8_t &day) const {
+  days2date(_time / SECONDS_PER_DAY, year, month, day);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Return the year.
+    @return Year (range: 1970--2105).
+*/
+/**************************************************************************/
+uint16_t DateTime::year() const {
+  uint16_t y;
+  uint8_t m, d;
+  date(y, m, d);
+  return y;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Return the month.
+    @return Month number (1--12).
+*/
+/**************************************************************************/
+uint8_t DateTime::month() const {
+  uint16_t y;
+  uint8_t m, d;
+  date(y, m, d);
+  return m;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Return the day of the month.
+    @return Day of the month (1--31).
+*/
+/**************************************************************************/
+uint8_t DateTime::day() const {
+  uint16_t y;
+  uint8_t m, d;
+  date(y, m, d);
+  return d;
 }
 
 /**************************************************************************/
@@ -325,7 +374,7 @@ bool DateTime::isValid() const {
 
     | specifier | output                                                 |
     |-----------|--------------------------------------------------------|
-    | YYYY      | the year as a 4-digit number (2000--2099)              |
+    | YYYY      | the year as a 4-digit number (1970--2105)              |
     | YY        | the year as a 2-digit number (00--99)                  |
     | MM        | the month as a 2-digit number (01--12)                 |
     | MMM       | the abbreviated English month name ("Jan"--"Dec")      |
@@ -363,6 +412,10 @@ bool DateTime::isValid() const {
 /**************************************************************************/
 
 char *DateTime::toString(char *buffer) const {
+  uint16_t y;
+  uint8_t m, d;
+  date(y, m, d);
+  uint8_t hh = hour(), mm = minute(), ss = second();
   uint8_t apTag =
       (strstr(buffer, "ap") != nullptr) || (strstr(buffer, "AP") != nullptr);
   uint8_t hourReformatted = 0, isPM = false;
@@ -423,13 +476,13 @@ char *DateTime::toString(char *buffer) const {
     }
     if (buffer[i] == 'Y' && buffer[i + 1] == 'Y' && buffer[i + 2] == 'Y' &&
         buffer[i + 3] == 'Y') {
-      buffer[i] = '2';
-      buffer[i + 1] = '0';
-      buffer[i + 2] = '0' + (yOff / 10) % 10;
-      buffer[i + 3] = '0' + yOff % 10;
+      buffer[i] = '0' + y / 1000;
+      buffer[i + 1] = '0' + (y / 100) % 10;
+      buffer[i + 2] = '0' + (y / 10) % 10;
+      buffer[i + 3] = '0' + y % 10;
     } else if (buffer[i] == 'Y' && buffer[i + 1] == 'Y') {
-      buffer[i] = '0' + (yOff / 10) % 10;
-      buffer[i + 1] = '0' + yOff % 10;
+      buffer[i] = '0' + (y / 10) % 10;
+      buffer[i + 1] = '0' + y % 10;
     }
     if (buffer[i] == 'A' && buffer[i + 1] == 'P') {
       if (isPM) {
@@ -459,6 +512,7 @@ char *DateTime::toString(char *buffer) const {
 */
 /**************************************************************************/
 uint8_t DateTime::twelveHour() const {
+  uint8_t hh = hour();
   if (hh == 0 || hh == 12) { // midnight or noon
     return 12;
   } else if (hh > 12) { // 1 o'clock or later
@@ -475,127 +529,8 @@ uint8_t DateTime::twelveHour() const {
 */
 /**************************************************************************/
 uint8_t DateTime::dayOfTheWeek() const {
-  uint16_t day = date2days(yOff, m, d);
-  return (day + 6) % 7; // Jan 1, 2000 is a Saturday, i.e. returns 6
-}
-
-/**************************************************************************/
-/*!
-    @brief  Return Unix time: seconds since 1 Jan 1970.
-
-    @see The `DateTime::DateTime(uint32_t)` constructor is the converse of
-        this method.
-
-    @return Number of seconds since 1970-01-01 00:00:00.
-*/
-/**************************************************************************/
-uint32_t DateTime::unixtime(void) const {
-  uint32_t t;
-  uint16_t days = date2days(yOff, m, d);
-  t = time2ulong(days, hh, mm, ss);
-  t += SECONDS_FROM_1970_TO_2000; // seconds from 1970 to 2000
-
-  return t;
-}
-
-/**************************************************************************/
-/*!
-    @brief  Convert the DateTime to seconds since 1 Jan 2000
-
-    The result can be converted back to a DateTime with:
-
-    ```cpp
-    DateTime(SECONDS_FROM_1970_TO_2000 + value)
-    ```
-
-    @return Number of seconds since 2000-01-01 00:00:00.
-*/
-/**************************************************************************/
-uint32_t DateTime::secondstime(void) const {
-  uint32_t t;
-  uint16_t days = date2days(yOff, m, d);
-  t = time2ulong(days, hh, mm, ss);
-  return t;
-}
-
-/**************************************************************************/
-/*!
-    @brief  Add a TimeSpan to the DateTime object
-    @param span TimeSpan object
-    @return New DateTime object with span added to it.
-*/
-/**************************************************************************/
-DateTime DateTime::operator+(const TimeSpan &span) const {
-  return DateTime(unixtime() + span.totalseconds());
-}
-
-/**************************************************************************/
-/*!
-    @brief  Subtract a TimeSpan from the DateTime object
-    @param span TimeSpan object
-    @return New DateTime object with span subtracted from it.
-*/
-/**************************************************************************/
-DateTime DateTime::operator-(const TimeSpan &span) const {
-  return DateTime(unixtime() - span.totalseconds());
-}
-
-/**************************************************************************/
-/*!
-    @brief  Subtract one DateTime from another
-
-    @note Since a TimeSpan cannot be negative, the subtracted DateTime
-        should be less (earlier) than or equal to the one it is
-        subtracted from.
-
-    @param right The DateTime object to subtract from self (the left object)
-    @return TimeSpan of the difference between DateTimes.
-*/
-/**************************************************************************/
-TimeSpan DateTime::operator-(const DateTime &right) const {
-  return TimeSpan(unixtime() - right.unixtime());
-}
-
-/**************************************************************************/
-/*!
-    @author Anton Rieutskyi
-    @brief  Test if one DateTime is less (earlier) than another.
-    @warning if one or both DateTime objects are invalid, returned value is
-        meaningless
-    @see use `isValid()` method to check if DateTime object is valid
-    @param right Comparison DateTime object
-    @return True if the left DateTime is earlier than the right one,
-        false otherwise.
-*/
-/**************************************************************************/
-bool DateTime::operator<(const DateTime &right) const {
-  return (yOff + 2000U < right.year() ||
-          (yOff + 2000U == right.year() &&
-           (m < right.month() ||
-            (m == right.month() &&
-             (d < right.day() ||
-              (d == right.day() &&
-               (hh < right.hour() ||
-                (hh == right.hour() &&
-                 (mm < right.minute() ||
-                  (mm == right.minute() && ss < right.second()))))))))));
-}
-
-/**************************************************************************/
-/*!
-    @author Anton Rieutskyi
-    @brief  Test if two DateTime objects are equal.
-    @warning if one or both DateTime objects are invalid, returned value is
-        meaningless
-    @see use `isValid()` method to check if DateTime object is valid
-    @param right Comparison DateTime object
-    @return True if both DateTime objects are the same, false otherwise.
-*/
-/**************************************************************************/
-bool DateTime::operator==(const DateTime &right) const {
-  return (right.year() == yOff + 2000U && right.month() == m &&
-          right.day() == d && right.hour() == hh && right.minute() == mm &&
-          right.second() == ss);
+  uint32_t day = _time / SECONDS_PER_DAY;
+  return (day + 4) % 7; // Jan 1, 1970 is a Thursday, i.e. returns 4
 }
 
 /**************************************************************************/
@@ -614,7 +549,11 @@ bool DateTime::operator==(const DateTime &right) const {
 */
 /**************************************************************************/
 String DateTime::timestamp(timestampOpt opt) const {
-  char buffer[25]; // large enough for any DateTime, including invalid ones
+  char buffer[26]; // large enough for any DateTime, including invalid ones
+  uint16_t y;
+  uint8_t m, d;
+  date(y, m, d);
+  uint8_t hh = hour(), mm = minute(), ss = second();
 
   // Generate timestamp according to opt
   switch (opt) {
@@ -624,12 +563,11 @@ String DateTime::timestamp(timestampOpt opt) const {
     break;
   case TIMESTAMP_DATE:
     // Only date
-    sprintf(buffer, "%u-%02d-%02d", 2000U + yOff, m, d);
+    sprintf(buffer, "%u-%02d-%02d", y, m, d);
     break;
   default:
     // Full
-    sprintf(buffer, "%u-%02d-%02dT%02d:%02d:%02d", 2000U + yOff, m, d, hh, mm,
-            ss);
+    sprintf(buffer, "%u-%02d-%02dT%02d:%02d:%02d", y, m, d, hh, mm, ss);
   }
   return String(buffer);
 }
@@ -7,7 +7,7 @@
 #ifndef DATETIME_H
 #define DATETIME_H
 
-#include <Arduino.h>
+#include "arduino_compat.h"
 
 /** Constants */
 #define SECONDS_PER_DAY 86400L ///< 60 * 60 * 24
@@ -70,14 +70,15 @@ protected:
     @brief  Simple general-purpose date/time class (no TZ / DST / leap
             seconds).
 
-    This class stores date and time information in a broken-down form, as a
-    tuple (year, month, day, hour, minute, second). The day of the week is
-    not stored, but computed on request. The class has no notion of time
-    zones, daylight saving time, or
+    This class stores date and time information as seconds since
+    1970-01-01 00:00:00, so that comparisons and arithmetic are single
+    integer operations. The calendar fields (year, month, day, ...) and the
+    day of the week are not stored, but computed on request. The class has no
+    notion of time zones, daylight saving time, or
     [leap seconds](http://en.wikipedia.org/wiki/Leap_second): time is stored
     in whatever time zone the user chooses to use.
 
-    The class supports dates in the range from 1 Jan 2000 to 31 Dec 2099
+    The class supports dates in the range from 1 Jan 1970 to 31 Dec 2105
     inclusive.
 */
 /**************************************************************************/
@@ -93,51 +94,39 @@ public:
   bool isValid() const;
   char *toString(char *buffer) const;
 
-  /*!
-      @brief  Return the year.
-      @return Year (range: 2000--2099).
-  */
-  uint16_t year() const { return 2000U + yOff; }
-  /*!
-      @brief  Return the month.
-      @return Month number (1--12).
-  */
-  uint8_t month() const { return m; }
-  /*!
-      @brief  Return the day of the month.
-      @return Day of the month (1--31).
-  */
-  uint8_t day() const { return d; }
+  uint16_t year() const;
+  uint8_t month() const;
+  uint8_t day() const;
   /*!
       @brief  Return the hour
       @return Hour (0--23).
   */
-  uint8_t hour() const { return hh; }
+  uint8_t hour() const { return _time / 3600 % 24; }
 
   uint8_t twelveHour() const;
   /*!
       @brief  Return whether the time is PM.
       @return 0 if the time is AM, 1 if it's PM.
   */
-  uint8_t isPM() const { return hh >= 12; }
+  uint8_t isPM() const { return hour() >= 12; }
   /*!
       @brief  Return the minute.
       @return Minute (0--59).
   */
-  uint8_t minute() const { return mm; }
+  uint8_t minute() const { return _time / 60 % 60; }
   /*!
       @brief  Return the second.
       @return Second (0--59).
   */
-  uint8_t second() const { return ss; }
+  uint8_t second() const { return _time % 60; }
 
   uint8_t dayOfTheWeek() const;
 
   /* 32-bit times as seconds since 2000-01-01. */
-  uint32_t secondstime() const;
+  uint32_t secondstime() const { return _time - SECONDS_FROM_1970_TO_2000; }
 
   /* 32-bit times as seconds since 1970-01-01. */
-  uint32_t unixtime(void) const;
+  uint32_t unixtime(void) const { return _time; }
 
   /*!
       Format of the ISO 8601 timestamp generated by `timestamp()`. Each
@@ -150,10 +139,41 @@ public:
   };
   String timestamp(timestampOpt opt = TIMESTAMP_FULL) const;
 
-  DateTime operator+(const TimeSpan &span) const;
-  DateTime operator-(const TimeSpan &span) const;
-  TimeSpan operator-(const DateTime &right) const;
-  bool operator<(const DateTime &right) const;
+  /*!
+      @brief  Add a TimeSpan to the DateTime object
+      @param span TimeSpan object
+      @return New DateTime object with span added to it.
+  */
+  DateTime operator+(const TimeSpan &span) const {
+    return DateTime(_time + span.totalseconds());
+  }
+  /*!
+      @brief  Subtract a TimeSpan from the DateTime object
+      @param span TimeSpan object
+      @return New DateTime object with span subtracted from it.
+  */
+  DateTime operator-(const TimeSpan &span) const {
+    return DateTime(_time - span.totalseconds());
+  }
+  /*!
+      @brief  Subtract one DateTime from another
+      @param right The DateTime object to subtract from self (the left object)
+      @return TimeSpan of the difference between DateTimes, negative if
+        right is later.
+  */
+  TimeSpan operator-(const DateTime &right) const {
+    return TimeSpan((int32_t)(_time - right._time));
+  }
+  /*!
+      @brief  Test if one DateTime is less (earlier) than another.
+      @warning if one or both DateTime objects are invalid, returned value is
+        meaningless
+      @see use `isValid()` method to check if DateTime object is valid
+      @param right Comparison DateTime object
+      @return True if the left DateTime is earlier than the right one,
+        false otherwise.
+  */
+  bool operator<(const DateTime &right) const { return _time < right._time; }
 
   /*!
       @brief  Test if one DateTime is greater (later) than another.
@@ -187,7 +207,15 @@ public:
         one, false otherwise
   */
   bool operator>=(const DateTime &right) const { return !(*this < right); }
-  bool operator==(const DateTime &right) const;
+  /*!
+      @brief  Test if two DateTime objects are equal.
+      @warning if one or both DateTime objects are invalid, returned value is
+        meaningless
+      @see use `isValid()` method to check if DateTime object is valid
+      @param right Comparison DateTime object
+      @return True if both DateTime objects are the same, false otherwise.
+  */
+  bool operator==(const DateTime &right) const { return _time == right._time; }
 
   /*!
       @brief  Test if two DateTime objects are not equal.
@@ -200,12 +228,9 @@ public:
   bool operator!=(const DateTime &right) const { return !(*this == right); }
 
 protected:
-  uint8_t yOff; ///< Year offset from 2000
-  uint8_t m;    ///< Month 1-12
-  uint8_t d;    ///< Day 1-31
-  uint8_t hh;   ///< Hours 0-23
-  uint8_t mm;   ///< Minutes 0-59
-  uint8_t ss;   ///< Seconds 0-59
+  void date(uint16_t &year, uint8_t &month, uint8_t &day) const;
+
+  uint32_t _time; ///< Seconds since 1970-01-01 00:00:00, UINT32_MAX if invalid
 };
 
 #endif // DATETIME_H
@@ -0,0 +1,56 @@
+#include "efa_request.h"
+
+#include <stdio.h>
+
+// The website asks for a lot more: the trips' stops, departures of nearby and
+// assigned stops and stop candidates. All of it would be sent over TLS and
+// skipped by the parser, so we only ask for the one stop and its next few
+// departures.
+static const char format[] =
+	"/efa/XML_DM_REQUEST"
+	"?outputFormat=rapidJSON"
+	// Exactly this stop. No search for it, no list of candidates.
+	"&type_dm=stop&name_dm=%s&mode=direct"
+	"&depType=stopEvents&itdDateTimeDepArr=dep"
+	"&limit=%u"
+	"&useRealtime=%u"
+	// Without departures of the stops the server considers part of this one
+	// and of those in walking distance.
+	"&deleteAssignedStops_dm=1&useProxFootSearch=0"
+	// Without the stops of every trip.
+	"&includeCompleteStopSeq=0";
+
+static bool is_unreserved(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+		|| c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+// Percent-encodes s into buffer. Returns false if it didn't fit.
+static bool encode(char *buffer, size_t size, const char *s) {
+	static const char hex[] = "0123456789ABCDEF";
+	size_t n = 0;
+	for (; *s; s++) {
+		unsigned char c = *s;
+		if (is_unreserved(c)) {
+			if (n + 1 >= size) return false;
+			buffer[n++] = c;
+		} else {
+			if (n + 3 >= size) return false;
+			buffer[n++] = '%';
+			buffer[n++] = hex[c >> 4];
+			buffer[n++] = hex[c & 0xF];
+		}
+	}
+	buffer[n] = '\0';
+	return true;
+}
+
+size_t efa_departure_request_uri(char *buffer, size_t size, EfaDepartureRequest const &request) {
+	// Stop IDs are short, this leaves plenty of room.
+	char stopId[64];
+	if (!encode(stopId, sizeof(stopId), request.stopId)) return 0;
+
+	int n = snprintf(buffer, size, format, stopId, (unsigned)request.limit, request.realtime ? 1u : 0u);
+	if (n < 0 || (size_t)n >= size) return 0;
+	return n;
+}
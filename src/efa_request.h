@@ -0,0 +1,23 @@
+#ifndef EFA_REQUEST
+#define EFA_REQUEST
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What to ask the EFA departure monitor (XML_DM_REQUEST) for. Everything that
+// is not needed for the display is left out of the response.
+struct EfaDepartureRequest {
+	// Global ID of the stop, like "de:09761:101". This is the "id" of the stop
+	// in the responses of the website.
+	const char *stopId;
+	// At most this many departures, counted over all platforms.
+	uint8_t limit;
+	// Ask for departureTimeEstimated.
+	bool realtime;
+};
+
+// Writes the path and query of the request, which goes after the host, into
+// buffer. Returns its length or 0 if it didn't fit.
+size_t efa_departure_request_uri(char *buffer, size_t size, EfaDepartureRequest const &request);
+
+#endif // EFA_REQUEST
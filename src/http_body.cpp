@@ -0,0 +1,136 @@
+#include "http_body.h"
+
+// See RFC 9112, section 7.1 for the chunked transfer coding:
+//
+//     chunk-size [ ; extensions ] CRLF
+//     chunk-data CRLF
+//     ...
+//     0 [ ; extensions ] CRLF
+//     [ trailer fields CRLF ... ]
+//     CRLF
+
+void HttpBody::begin(Stream &stream, bool chunked, int size) {
+	this->stream = &stream;
+	this->chunked = chunked;
+	seen = false;
+	if (chunked) {
+		state = STATE_SIZE;
+		left = 0;
+	} else {
+		state = size == 0 ? STATE_DONE : STATE_DATA;
+		left = size < 0 ? SIZE_MAX : (size_t)size;
+	}
+}
+
+void HttpBody::frame() {
+	while (state != STATE_DATA && state != STATE_DONE && state != STATE_ERROR
+			&& stream->available() > 0) {
+		int c = stream->read();
+		if (c < 0) return;
+
+		switch (state) {
+		case STATE_SIZE: {
+			int digit = -1;
+			if (c >= '0' && c <= '9') digit = c - '0';
+			else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+			if (digit >= 0) {
+				if (left > SIZE_MAX >> 4) {
+					state = STATE_ERROR;
+					break;
+				}
+				left = left * 16 + digit;
+				seen = true;
+			} else if (seen && (c == ';' || c == ' ' || c == '\t')) {
+				state = STATE_EXTENSION;
+			} else if (seen && c == '\r') {
+				state = STATE_SIZE_LF;
+			} else {
+				state = STATE_ERROR;
+			}
+			break;
+		}
+		case STATE_EXTENSION:
+			if (c == '\r') state = STATE_SIZE_LF;
+			break;
+		case STATE_SIZE_LF:
+			if (c != '\n') {
+				state = STATE_ERROR;
+			} else if (left == 0) {
+				seen = false;
+				state = STATE_TRAILER;
+			} else {
+				state = STATE_DATA;
+			}
+			break;
+		case STATE_DATA_CR:
+			state = c == '\r' ? STATE_DATA_LF : STATE_ERROR;
+			break;
+		case STATE_DATA_LF:
+			seen = false;
+			state = c == '\n' ? STATE_SIZE : STATE_ERROR;
+			break;
+		case STATE_TRAILER:
+		case STATE_TRAILER_LINE:
+			if (c == '\r') {
+				state = STATE_TRAILER_LF;
+			} else {
+				seen = true;
+				state = STATE_TRAILER_LINE;
+			}
+			break;
+		case STATE_TRAILER_LF:
+			if (c != '\n') {
+				state = STATE_ERROR;
+			} else if (seen) {
+				// End of a trailer field
+				seen = false;
+				state = STATE_TRAILER;
+			} else {
+				state = STATE_DONE;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void HttpBody::consumed(size_t count) {
+	if (left != SIZE_MAX) left -= count;
+	if (left > 0) return;
+	state = chunked ? STATE_DATA_CR : STATE_DONE;
+	frame();
+}
+
+int HttpBody::available() {
+	frame();
+	if (state != STATE_DATA) return 0;
+	int available = stream->available();
+	if (available <= 0) return 0;
+	return (size_t)available < left ? available : (int)left;
+}
+
+int HttpBody::read() {
+	if (available() <= 0) return -1;
+	int c = stream->read();
+	if (c >= 0) consumed(1);
+	return c;
+}
+
+int HttpBody::peek() {
+	if (available() <= 0) return -1;
+	return stream->peek();
+}
+
+size_t HttpBody::readBytes(char *buffer, size_t length) {
+	// Only what is there already, so this doesn't run into the stream's timeout
+	// in the middle of the framing.
+	int available = this->available();
+	if (available <= 0) return 0;
+	if (length > (size_t)available) length = available;
+
+	size_t n = stream->readBytes(buffer, length);
+	consumed(n);
+	return n;
+}
@@ -0,0 +1,67 @@
+#ifndef HTTP_BODY
+#define HTTP_BODY
+
+#include "arduino_compat.h"
+
+// The body of an HTTP response as a Stream, read straight from the connection.
+// Chunked transfer coding is taken apart on the way: readers only see the
+// payload, which is read into their buffer without being copied anywhere
+// else first. Like the connection, it never waits in available(), and it
+// knows where the body ends, so readers don't have to wait for the server to
+// close the connection, which a kept connection never does.
+class HttpBody : public Stream {
+public:
+	// size is the Content-Length or -1 if there is none. Chunked bodies
+	// ignore it.
+	void begin(Stream &stream, bool chunked, int size);
+
+	// The whole body was read. Bodies without a length and chunking only end
+	// with the connection, which this can't see.
+	bool done() const { return state == STATE_DONE; }
+	// The chunk framing was invalid.
+	bool failed() const { return state == STATE_ERROR; }
+
+	int available() override;
+	int read() override;
+	int peek() override;
+	size_t readBytes(char *buffer, size_t length) override;
+
+	// Responses can't be written to.
+	size_t write(uint8_t) override { return 0; }
+	void flush() override {}
+
+private:
+	enum State : uint8_t {
+		// Chunk size in hex
+		STATE_SIZE,
+		// Chunk extensions after the size, which are ignored
+		STATE_EXTENSION,
+		STATE_SIZE_LF,
+		STATE_DATA,
+		// CRLF after the data of a chunk
+		STATE_DATA_CR,
+		STATE_DATA_LF,
+		// Trailer fields after the last chunk, ended by an empty line
+		STATE_TRAILER,
+		STATE_TRAILER_LINE,
+		STATE_TRAILER_LF,
+		STATE_DONE,
+		STATE_ERROR,
+	};
+
+	// Consumes whatever framing is available up to the next payload byte.
+	void frame();
+	// Account for count payload bytes that were read.
+	void consumed(size_t count);
+
+	Stream *stream = nullptr;
+	bool chunked = false;
+	State state = STATE_DONE;
+	// Payload left in the current chunk or body, SIZE_MAX if unknown.
+	size_t left = 0;
+	// Whether the chunk size line has a digit yet, or the trailer line has
+	// any character.
+	bool seen = false;
+};
+
+#endif // HTTP_BODY
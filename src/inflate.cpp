@@ -0,0 +1,456 @@
+#include "inflate.h"
+
+#include <string.h>
+
+#include "arduino_compat.h"
+
+// See RFC 1950 (zlib), RFC 1951 (deflate) and RFC 1952 (gzip). Every state
+// only consumes its input once all of it is there, so a chunk can end
+// anywhere. Huffman codes are decoded a bit at a time, which is slow compared
+// to table lookups but needs no tables, and the radio is still the bottleneck.
+
+enum {
+	STATE_GZIP_HEADER,
+	STATE_GZIP_EXTRA_LENGTH,
+	STATE_GZIP_EXTRA,
+	STATE_GZIP_NAME,
+	STATE_GZIP_COMMENT,
+	STATE_GZIP_HEADER_CRC,
+	STATE_ZLIB_HEADER,
+	STATE_BLOCK,
+	STATE_STORED_LENGTH,
+	STATE_STORED,
+	STATE_TABLE_COUNTS,
+	STATE_TABLE_LENGTH_CODES,
+	STATE_TABLE_LENGTHS,
+	STATE_LENGTH,
+	STATE_DISTANCE,
+	STATE_DISTANCE_EXTRA,
+	STATE_TRAILER,
+	STATE_TRAILER_SIZE,
+	STATE_END,
+};
+
+enum {
+	GZIP_FHCRC = 0x02,
+	GZIP_FEXTRA = 0x04,
+	GZIP_FNAME = 0x08,
+	GZIP_FCOMMENT = 0x10,
+};
+
+static const uint16_t lengthBases[29] PROGMEM = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtras[29] PROGMEM = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBases[30] PROGMEM = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distanceExtras[30] PROGMEM = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// Order in which the lengths of the code length code are sent
+static const uint8_t lengthCodeOrder[19] PROGMEM = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+struct Input {
+	const uint8_t *cursor;
+	const uint8_t *end;
+};
+
+// Tops up the bit buffer with whole bytes as far as it goes.
+static void fill(Inflate *inflate, Input *input) {
+	while (inflate->bitCount <= 24 && input->cursor < input->end) {
+		inflate->bits |= (uint32_t)*input->cursor++ << inflate->bitCount;
+		inflate->bitCount += 8;
+	}
+}
+
+// Whether count bits are there. Reads as much as needed.
+static bool need(Inflate *inflate, Input *input, uint8_t count) {
+	fill(inflate, input);
+	return inflate->bitCount >= count;
+}
+
+static uint32_t peek(Inflate *inflate, uint8_t count) {
+	return count == 32 ? inflate->bits : inflate->bits & (((uint32_t)1 << count) - 1);
+}
+
+static void drop(Inflate *inflate, uint8_t count) {
+	inflate->bits = count == 32 ? 0 : inflate->bits >> count;
+	inflate->bitCount -= count;
+}
+
+static uint32_t take(Inflate *inflate, uint8_t count) {
+	uint32_t value = peek(inflate, count);
+	drop(inflate, count);
+	return value;
+}
+
+// Makes code the canonical Huffman code for the given code lengths. Fails for
+// lengths that use more codes than there are. Fewer are fine, deflate sends
+// those for single distance codes.
+static bool build(InflateCode *code, const uint8_t *lengths, uint16_t count) {
+	memset(code->counts, 0, sizeof(code->counts));
+	for (uint16_t i = 0; i < count; i++) code->counts[lengths[i]]++;
+	code->counts[0] = 0;
+
+	int left = 1;
+	for (uint8_t length = 1; length < 16; length++) {
+		left <<= 1;
+		left -= code->counts[length];
+		if (left < 0) return false;
+	}
+
+	uint16_t offsets[16];
+	offsets[1] = 0;
+	for (uint8_t length = 1; length < 15; length++) {
+		offsets[length + 1] = offsets[length] + code->counts[length];
+	}
+	for (uint16_t i = 0; i < count; i++) {
+		if (lengths[i] != 0) code->symbols[offsets[lengths[i]]++] = i;
+	}
+	return true;
+}
+
+// Decodes the next symbol without consuming it. Returns the length of its code,
+// 0 if more bits are needed or -1 for an invalid code.
+static int decode(Inflate const *inflate, InflateCode const *code, uint16_t *symbol) {
+	uint32_t bits = inflate->bits;
+	int value = 0;
+	int first = 0;
+	int index = 0;
+	for (uint8_t length = 1; length < 16; length++) {
+		if (length > inflate->bitCount) return 0;
+		value |= bits & 1;
+		bits >>= 1;
+		int count = code->counts[length];
+		if (value - count < first) {
+			*symbol = code->symbols[index + (value - first)];
+			return length;
+		}
+		index += count;
+		first = (first + count) << 1;
+		value <<= 1;
+	}
+	return -1;
+}
+
+static void fixed_codes(Inflate *inflate) {
+	uint8_t *lengths = inflate->lengths;
+	memset(lengths, 8, 144);
+	memset(lengths + 144, 9, 256 - 144);
+	memset(lengths + 256, 7, 280 - 256);
+	memset(lengths + 280, 8, 288 - 280);
+	build(&inflate->literals, lengths, 288);
+	memset(lengths, 5, 30);
+	build(&inflate->distances, lengths, 30);
+}
+
+// Hands the output since the last flush to the sink.
+static bool flush(Inflate *inflate) {
+	if (inflate->head == inflate->flushed) return true;
+	bool more = inflate->sink((const char *)inflate->window + inflate->flushed,
+		inflate->head - inflate->flushed, inflate->userData);
+	inflate->flushed = inflate->head;
+	if (!more) inflate->status = INFLATE_STOPPED;
+	return more;
+}
+
+// Starts over at the beginning of the window once it is full.
+static bool wrap(Inflate *inflate) {
+	if (inflate->head < inflate->windowSize) return true;
+	bool more = flush(inflate);
+	inflate->head = inflate->flushed = 0;
+	return more;
+}
+
+static bool put(Inflate *inflate, uint8_t byte) {
+	inflate->window[inflate->head++] = byte;
+	inflate->total++;
+	return wrap(inflate);
+}
+
+static bool copy(Inflate *inflate, uint16_t distance, uint16_t length) {
+	size_t mask = inflate->windowSize - 1;
+	size_t from = (inflate->head - distance) & mask;
+	while (length--) {
+		if (!put(inflate, inflate->window[from])) return false;
+		from = (from + 1) & mask;
+	}
+	return true;
+}
+
+static bool fail(Inflate *inflate) {
+	inflate->status = INFLATE_ERROR;
+	return false;
+}
+
+// Runs the state machine until the input runs out or the body ends. Returns
+// false if it can't go on.
+static bool run(Inflate *inflate, Input *input) {
+	while (true) {
+		switch (inflate->state) {
+		case STATE_GZIP_HEADER: {
+			// ID1, ID2, CM, FLG, MTIME, XFL and OS
+			if (!need(inflate, input, 8)) return true;
+			uint8_t byte = take(inflate, 8);
+			uint16_t offset = 10 - inflate->left--;
+			if ((offset == 0 && byte != 0x1f) || (offset == 1 && byte != 0x8b) || (offset == 2 && byte != 8)) {
+				return fail(inflate);
+			}
+			if (offset == 3) inflate->flags = byte;
+			if (inflate->left == 0) inflate->state = STATE_GZIP_EXTRA_LENGTH;
+			break;
+		}
+		case STATE_GZIP_EXTRA_LENGTH:
+			if (!(inflate->flags & GZIP_FEXTRA)) {
+				inflate->state = STATE_GZIP_NAME;
+				break;
+			}
+			if (!need(inflate, input, 16)) return true;
+			inflate->left = take(inflate, 16);
+			inflate->state = STATE_GZIP_EXTRA;
+			break;
+		case STATE_GZIP_EXTRA:
+			if (inflate->left == 0) {
+				inflate->state = STATE_GZIP_NAME;
+				break;
+			}
+			if (!need(inflate, input, 8)) return true;
+			drop(inflate, 8);
+			inflate->left--;
+			break;
+		case STATE_GZIP_NAME:
+		case STATE_GZIP_COMMENT: {
+			// Both are zero-terminated
+			uint8_t flag = inflate->state == STATE_GZIP_NAME ? GZIP_FNAME : GZIP_FCOMMENT;
+			if (inflate->flags & flag) {
+				if (!need(inflate, input, 8)) return true;
+				if (take(inflate, 8) != 0) break;
+			}
+			inflate->state++;
+			break;
+		}
+		case STATE_GZIP_HEADER_CRC:
+			if (inflate->flags & GZIP_FHCRC) {
+				if (!need(inflate, input, 16)) return true;
+				drop(inflate, 16);
+			}
+			inflate->state = STATE_BLOCK;
+			break;
+		case STATE_ZLIB_HEADER: {
+			if (!need(inflate, input, 16)) return true;
+			uint8_t method = take(inflate, 8);
+			uint8_t flags = take(inflate, 8);
+			bool dictionary = flags & 0x20;
+			size_t windowSize = (size_t)1 << ((method >> 4) + 8);
+			if ((method & 0x0f) != 8 || (method * 256 + flags) % 31 != 0 || dictionary) return fail(inflate);
+			if (windowSize > inflate->windowSize) return fail(inflate);
+			inflate->state = STATE_BLOCK;
+			break;
+		}
+		case STATE_BLOCK: {
+			if (inflate->lastBlock) {
+				drop(inflate, inflate->bitCount % 8);
+				inflate->state = STATE_TRAILER;
+				break;
+			}
+			if (!need(inflate, input, 3)) return true;
+			inflate->lastBlock = take(inflate, 1);
+			switch (take(inflate, 2)) {
+			case 0:
+				drop(inflate, inflate->bitCount % 8);
+				inflate->state = STATE_STORED_LENGTH;
+				break;
+			case 1:
+				fixed_codes(inflate);
+				inflate->state = STATE_LENGTH;
+				break;
+			case 2:
+				inflate->state = STATE_TABLE_COUNTS;
+				break;
+			default:
+				return fail(inflate);
+			}
+			break;
+		}
+		case STATE_STORED_LENGTH: {
+			if (!need(inflate, input, 32)) return true;
+			uint16_t length = take(inflate, 16);
+			uint16_t complement = take(inflate, 16);
+			if (length != (uint16_t)~complement) return fail(inflate);
+			inflate->left = length;
+			inflate->state = STATE_STORED;
+			break;
+		}
+		case STATE_STORED:
+			while (inflate->left > 0 && inflate->bitCount > 0) {
+				if (!put(inflate, take(inflate, 8))) return false;
+				inflate->left--;
+			}
+			while (inflate->left > 0 && input->cursor < input->end) {
+				size_t count = inflate->windowSize - inflate->head;
+				if (count > inflate->left) count = inflate->left;
+				if (count > (size_t)(input->end - input->cursor)) count = input->end - input->cursor;
+				memcpy(inflate->window + inflate->head, input->cursor, count);
+				input->cursor += count;
+				inflate->left -= count;
+				inflate->head += count;
+				inflate->total += count;
+				if (!wrap(inflate)) return false;
+			}
+			if (inflate->left > 0) return true;
+			inflate->state = STATE_BLOCK;
+			break;
+		case STATE_TABLE_COUNTS:
+			if (!need(inflate, input, 14)) return true;
+			inflate->literalCount = take(inflate, 5) + 257;
+			inflate->distanceCount = take(inflate, 5) + 1;
+			inflate->lengthCodeCount = take(inflate, 4) + 4;
+			if (inflate->literalCount > 286 || inflate->distanceCount > 30) return fail(inflate);
+			inflate->index = 0;
+			memset(inflate->lengths, 0, 19);
+			inflate->state = STATE_TABLE_LENGTH_CODES;
+			break;
+		case STATE_TABLE_LENGTH_CODES:
+			while (inflate->index < inflate->lengthCodeCount) {
+				if (!need(inflate, input, 3)) return true;
+				inflate->lengths[pgm_read_byte(lengthCodeOrder + inflate->index++)] = take(inflate, 3);
+			}
+			// The distance code isn't needed before the lengths are read.
+			if (!build(&inflate->distances, inflate->lengths, 19)) return fail(inflate);
+			inflate->index = 0;
+			inflate->state = STATE_TABLE_LENGTHS;
+			break;
+		case STATE_TABLE_LENGTHS: {
+			uint16_t count = inflate->literalCount + inflate->distanceCount;
+			while (inflate->index < count) {
+				fill(inflate, input);
+				uint16_t symbol;
+				int length = decode(inflate, &inflate->distances, &symbol);
+				if (length < 0) return fail(inflate);
+				if (length == 0) return true;
+				if (symbol < 16) {
+					drop(inflate, length);
+					inflate->lengths[inflate->index++] = symbol;
+					continue;
+				}
+
+				// Repeat the previous length or zero
+				static const uint8_t extras[3] = {2, 3, 7};
+				static const uint8_t bases[3] = {3, 3, 11};
+				uint8_t extra = extras[symbol - 16];
+				if (inflate->bitCount < length + extra) return true;
+				drop(inflate, length);
+				uint16_t repeat = bases[symbol - 16] + take(inflate, extra);
+				uint8_t value = 0;
+				if (symbol == 16) {
+					if (inflate->index == 0) return fail(inflate);
+					value = inflate->lengths[inflate->index - 1];
+				}
+				if (inflate->index + repeat > count) return fail(inflate);
+				memset(inflate->lengths + inflate->index, value, repeat);
+				inflate->index += repeat;
+			}
+			if (inflate->lengths[256] == 0) return fail(inflate);
+			if (!build(&inflate->literals, inflate->lengths, inflate->literalCount)) return fail(inflate);
+			if (!build(&inflate->distances, inflate->lengths + inflate->literalCount, inflate->distanceCount)) {
+				return fail(inflate);
+			}
+			inflate->state = STATE_LENGTH;
+			break;
+		}
+		case STATE_LENGTH: {
+			fill(inflate, input);
+			uint16_t symbol;
+			int length = decode(inflate, &inflate->literals, &symbol);
+			if (length < 0) return fail(inflate);
+			if (length == 0) return true;
+			if (symbol < 256) {
+				drop(inflate, length);
+				if (!put(inflate, symbol)) return false;
+				break;
+			}
+			if (symbol == 256) {
+				drop(inflate, length);
+				inflate->state = STATE_BLOCK;
+				break;
+			}
+			symbol -= 257;
+			if (symbol >= 29) return fail(inflate);
+			uint8_t extra = pgm_read_byte(lengthExtras + symbol);
+			if (inflate->bitCount < length + extra) return true;
+			drop(inflate, length);
+			inflate->length = pgm_read_word(lengthBases + symbol) + take(inflate, extra);
+			inflate->state = STATE_DISTANCE;
+			break;
+		}
+		case STATE_DISTANCE: {
+			fill(inflate, input);
+			uint16_t symbol;
+			int length = decode(inflate, &inflate->distances, &symbol);
+			if (length < 0) return fail(inflate);
+			if (length == 0) return true;
+			if (symbol >= 30) return fail(inflate);
+			// A code and its extra bits can take 28 bits, more than fill() is
+			// sure to have, so the extra bits are read on their own.
+			drop(inflate, length);
+			inflate->distanceCode = symbol;
+			inflate->state = STATE_DISTANCE_EXTRA;
+			break;
+		}
+		case STATE_DISTANCE_EXTRA: {
+			uint8_t extra = pgm_read_byte(distanceExtras + inflate->distanceCode);
+			if (!need(inflate, input, extra)) return true;
+			uint16_t distance = pgm_read_word(distanceBases + inflate->distanceCode) + take(inflate, extra);
+			// Further back than we remember
+			if (distance > inflate->windowSize || distance > inflate->total) return fail(inflate);
+			inflate->state = STATE_LENGTH;
+			if (!copy(inflate, distance, inflate->length)) return false;
+			break;
+		}
+		case STATE_TRAILER:
+			// CRC-32 for gzip, Adler-32 for zlib. TLS already makes sure that
+			// we got what was sent, so they aren't checked.
+			if (!need(inflate, input, 32)) return true;
+			drop(inflate, 32);
+			inflate->state = inflate->format == INFLATE_GZIP ? STATE_TRAILER_SIZE : STATE_END;
+			break;
+		case STATE_TRAILER_SIZE:
+			if (!need(inflate, input, 32)) return true;
+			if (take(inflate, 32) != inflate->total) return fail(inflate);
+			inflate->state = STATE_END;
+			break;
+		case STATE_END:
+			inflate->status = INFLATE_DONE;
+			return true;
+		}
+	}
+}
+
+void inflate_begin(Inflate *inflate, InflateFormat format, char *window, size_t windowSize,
+		InflateSink sink, void *userData) {
+	memset(inflate, 0, sizeof(*inflate));
+	inflate->sink = sink;
+	inflate->userData = userData;
+	inflate->format = format;
+	inflate->status = INFLATE_MORE;
+	inflate->window = (uint8_t *)window;
+	inflate->windowSize = windowSize;
+	if (format == INFLATE_GZIP) {
+		inflate->state = STATE_GZIP_HEADER;
+		inflate->left = 10;
+	} else {
+		inflate->state = STATE_ZLIB_HEADER;
+	}
+}
+
+InflateStatus inflate_feed(Inflate *inflate, const char *data, size_t size) {
+	if (inflate->status != INFLATE_MORE) return inflate->status;
+
+	Input input{(const uint8_t *)data, (const uint8_t *)data + size};
+	if (run(inflate, &input) && inflate->status != INFLATE_ERROR) flush(inflate);
+	return inflate->status;
+}
@@ -0,0 +1,91 @@
+#ifndef INFLATE
+#define INFLATE
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming decoder for gzip and zlib (Content-Encoding: gzip and deflate)
+// bodies. Like jimp's push mode, it takes the input in chunks of any size and
+// never waits for more. The output is handed to a sink straight out of the
+// window, so nothing but the window is buffered.
+
+enum InflateFormat {
+	INFLATE_GZIP,
+	INFLATE_ZLIB,
+};
+
+enum InflateStatus {
+	// Needs more input.
+	INFLATE_MORE,
+	// The whole body was decoded, including its trailer.
+	INFLATE_DONE,
+	// The sink did not want any more output.
+	INFLATE_STOPPED,
+	INFLATE_ERROR,
+};
+
+// Gets the output in order. Returning false stops the decoding.
+typedef bool (*InflateSink)(const char *data, size_t size, void *user_data);
+
+// Canonical Huffman code, see inflate_build.
+struct InflateCode {
+	// Number of codes of each length
+	uint16_t counts[16];
+	// Symbols ordered by code
+	uint16_t symbols[288];
+};
+
+// Everything the decoder needs to resume at an arbitrary byte.
+struct Inflate {
+	InflateSink sink;
+	void *userData;
+	InflateFormat format;
+	InflateStatus status;
+
+	// The last output, which matches refer back to. Output is handed to the sink
+	// from flushed up to head.
+	uint8_t *window;
+	size_t windowSize;
+	size_t head;
+	size_t flushed;
+	// Bytes put out so far, modulo 2^32 like in the gzip trailer.
+	uint32_t total;
+
+	// Input bits that were read but not used yet, least significant first.
+	uint32_t bits;
+	uint8_t bitCount;
+
+	uint8_t state;
+	bool lastBlock;
+	// gzip header flags
+	uint8_t flags;
+	// Bytes left of the current gzip header field or stored block.
+	uint16_t left;
+
+	// Dynamic block header
+	uint16_t literalCount;
+	uint16_t distanceCount;
+	uint16_t lengthCodeCount;
+	uint16_t index;
+	uint8_t lengths[288 + 32];
+
+	// Match being read, and the code of its distance until the extra bits
+	// of that are there
+	uint16_t length;
+	uint8_t distanceCode;
+
+	InflateCode literals;
+	InflateCode distances;
+};
+
+// Starts decoding a body in format. window must hold windowSize bytes, a power
+// of two. The server compresses with a window of up to 32 KiB, references
+// further back than windowSize fail the decoding.
+void inflate_begin(Inflate *inflate, InflateFormat format, char *window, size_t windowSize,
+		InflateSink sink, void *userData = nullptr);
+
+// Decodes size bytes at data. Once the decoding is done, stopped or failed,
+// further input is ignored.
+InflateStatus inflate_feed(Inflate *inflate, const char *data, size_t size);
+
+#endif // INFLATE
@@ -9,15 +9,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
 
-#ifdef ARDUINO
-#include <Arduino.h>
-#else
-struct Stream {
-};
+#include "arduino_compat.h"
+
+#ifndef ARDUINO
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 #endif
 
 // TODO: move all diagnostics reporting outside of the library
@@ -45,31 +51,230 @@ typedef enum {
     JIMP_NUMBER,
 } Jimp_Token;
 
+// What to do with a string or number token that does not fit into jimp->string.
+typedef enum {
+    // Grow jimp->string on the heap with realloc. Used when no arena is set.
+    JIMP_OVERFLOW_GROW,
+    // Keep what fits and set jimp->truncated. jimp->hash still covers the
+    // whole string, so member dispatch keeps working for long keys.
+    JIMP_OVERFLOW_TRUNCATE,
+    // Fail the token.
+    JIMP_OVERFLOW_ERROR,
+} Jimp_Overflow;
+
+// Size of the chunk that is pulled from the stream at once. The parser only
+// ever looks at the byte under the cursor, so this trades RAM for fewer calls
+// into the stream.
+#ifndef JIMP_INPUT_BUFFER_SIZE
+#define JIMP_INPUT_BUFFER_SIZE 256
+#endif
+
+// Count what every parse does in jimp->stats, see Jimp_Stats. Must be the same
+// in every file that includes jimp.h.
+#ifndef JIMP_STATS
+#define JIMP_STATS 0
+#endif
+
+// Implementation of the kernels that scan over whitespace, string bodies and
+// skipped values. All of them give the same results. The default is SSE2 or
+// AVX2 where the target has them and scalar everywhere else: SWAR has only
+// been measured on the host so far, and on the 32 bit Xtensa cores of the
+// ESP8266 and ESP32 it may well lose to the byte loop. Define JIMP_SCAN to
+// force one.
+#define JIMP_SCAN_SCALAR 0
+#define JIMP_SCAN_SWAR   1
+#define JIMP_SCAN_SSE2   2
+#define JIMP_SCAN_AVX2   3
+
+#ifndef JIMP_SCAN
+#if defined(__AVX2__)
+#define JIMP_SCAN JIMP_SCAN_AVX2
+#elif defined(__SSE2__)
+#define JIMP_SCAN JIMP_SCAN_SSE2
+#else
+#define JIMP_SCAN JIMP_SCAN_SCALAR
+#endif
+#endif
+
+// Events delivered to a Jimp_Handler in push mode. The payload of MEMBER,
+// STRING and NUMBER is in jimp->string, jimp->hash and jimp->number like for
+// the pull functions, and of BOOL in jimp->boolean. For the BEGIN and END
+// events jimp->push.depth is the depth of the container itself (0 for the
+// top-level one), for the others it is the number of enclosing containers.
+typedef enum {
+    JIMP_EVENT_OBJECT_BEGIN,
+    JIMP_EVENT_OBJECT_END,
+    JIMP_EVENT_ARRAY_BEGIN,
+    JIMP_EVENT_ARRAY_END,
+    JIMP_EVENT_MEMBER,
+    JIMP_EVENT_STRING,
+    JIMP_EVENT_NUMBER,
+    JIMP_EVENT_BOOL,
+    JIMP_EVENT_NULL,
+} Jimp_Event;
+
+// What a Jimp_Handler wants the push parser to do next.
+typedef enum {
+    JIMP_CONTINUE,
+    // After MEMBER: skip the member's value without any events for it.
+    // After OBJECT_BEGIN or ARRAY_BEGIN: skip the rest of the container. Its
+    // END event is not delivered either.
+    JIMP_SKIP,
+    // The handler has what it wants. The parse ends with JIMP_PUSH_DONE.
+    JIMP_STOP,
+    // The handler did not like what it got. The parse ends with JIMP_PUSH_ERROR.
+    JIMP_ABORT,
+} Jimp_Action;
+
+typedef enum {
+    // Everything fed so far was consumed, the value is not complete yet.
+    JIMP_PUSH_MORE,
+    // The top-level value is complete or the handler returned JIMP_STOP.
+    JIMP_PUSH_DONE,
+    JIMP_PUSH_ERROR,
+} Jimp_Push_Status;
+
+// The deepest nesting the push parser tracks. Containers that the handler
+// skips do not count.
+#define JIMP_PUSH_MAX_DEPTH 32
+
+typedef struct Jimp Jimp;
+typedef Jimp_Action (*Jimp_Handler)(Jimp *jimp, Jimp_Event event);
+
+// Everything the push parser needs to resume at an arbitrary byte.
+typedef struct {
+    Jimp_Handler handler;
+    Jimp_Push_Status status;
+    // Bit n is set if the container at depth n is an object.
+    uint32_t objects;
+    uint8_t depth;
+    // What the grammar allows next (Jimp__Expect) and which token is being
+    // read (Jimp__Lex).
+    uint8_t expect;
+    uint8_t lex;
+    // The handler skipped the member whose value comes next.
+    bool skip_value;
+    // The string being read is a member key.
+    bool key;
+    // The last byte of the string was a backslash.
+    bool escaped;
+    // The symbol (true, false, null) being read and how much of it matched.
+    uint8_t symbol;
+    uint8_t symbol_matched;
+    // Raw skip state, see jimp__skip_chunk.
+    int skip_depth;
+    bool skip_in_string;
+    bool skip_escaped;
+    // Containers to leave after the current event, see jimp_push_skip_enclosing.
+    uint8_t skip_enclosing;
+} Jimp_Push;
+
+#if JIMP_STATS
+// What one parse did, reset when it begins. Tells whether a slow parse waited
+// for its input or spent the time working on it.
 typedef struct {
-    // TODO: Add some fake stream thingie that yields chars one at a time so we
-    // can remove all of the switches.
+    // Bytes read from the source or fed in push mode.
+    size_t bytes;
+    // Bytes the raw skipper passed over without tokenizing them.
+    size_t bytes_skipped;
+    // Bytes copied into jimp->string.
+    size_t bytes_materialized;
+    // Tokens read, including punctuation.
+    size_t tokens;
+    // Most of jimp->string any token needed, including the NULL-terminator.
+    // Truncated tokens count as the whole string_capacity.
+    size_t peak_string;
+    // Microseconds spent waiting for input from the stream and working on it.
+    // Push mode counts the time spent in jimp_push_feed and in reading the
+    // stream in jimp_push_poll. Pull mode counts the time spent in refilling
+    // the input and everything between refills, including the caller's work.
+    uint32_t wait_us;
+    uint32_t parse_us;
+    // When the last refill returned, see jimp__refill.
+    uint32_t refilled_us;
+} Jimp_Stats;
+#endif
+
+struct Jimp {
 #ifdef ARDUINO
     Stream *stream;
 #else
-    char const *buffer;
+    // Host sources. Memory and mmap sources are parsed in place: cursor and
+    // end span the whole buffer and nothing is ever refilled. A file
+    // descriptor is read in chunks like a Stream on the device.
+    int fd;
+    void *mapping;
+    size_t mapping_size;
 #endif
-    int last_char;
-    int offset;
+    bool eof;
+
+    // Bytes in [cursor, end) have been read from the stream but not consumed
+    // yet. They live in input.
+    const char *cursor;
+    const char *end;
+    char input[JIMP_INPUT_BUFFER_SIZE];
 
     Jimp_Token token;
 
     char *string;
     size_t string_count;
     size_t string_capacity;
+    Jimp_Overflow overflow;
+    // Set when the last string or number did not fit into the arena.
+    bool truncated;
+    // jimp_hash of jimp->string, computed while the string is read.
+    uint32_t hash;
     double number;
+    // Set with jimp->number if the number was an integer, which is then also
+    // in jimp->integer.
+    bool is_integer;
+    int64_t integer;
     bool boolean;
 
+    // Number being read, see jimp__number_char.
+    uint64_t number_value;
+    uint8_t number_digits;
+    bool number_negative;
+    bool number_text;
+
+    Jimp_Push push;
+
+    // Members skipped by jimp_unexpected_member since the parse began.
+    uint16_t unexpected_members;
+    // The caller ended the parse early because it had what it wanted. Set by
+    // JIMP_STOP in push mode, pull mode callers set it themselves. The rest of
+    // the input was not read.
+    bool stopped;
+
+#if JIMP_STATS
+    Jimp_Stats stats;
+#endif
+
     void * user_data;
-} Jimp;
+};
 
 // TODO: how do null-s fit into this entire system?
 
+/// Makes jimp->string live in the caller's buffer instead of the heap. The arena
+/// outlives any number of jimp_begin calls. Tokens longer than size - 1 bytes
+/// are handled according to overflow.
+void jimp_arena(Jimp *jimp, char *arena, size_t size, Jimp_Overflow overflow);
+
+#ifdef ARDUINO
 void jimp_begin(Jimp *jimp, Stream &stream, void * user_data = nullptr);
+#else
+/// Parses size bytes at data. The buffer must outlive the parse.
+void jimp_begin_memory(Jimp *jimp, const char *data, size_t size, void * user_data = nullptr);
+
+/// Reads from fd (a file, pipe or socket) in chunks. The fd is not closed by jimp.
+void jimp_begin_fd(Jimp *jimp, int fd, void * user_data = nullptr);
+
+/// Maps the file at path and parses it in place. Release it with jimp_end.
+bool jimp_begin_mmap(Jimp *jimp, const char *path, void * user_data = nullptr);
+
+/// Releases whatever the jimp_begin_* call acquired.
+void jimp_end(Jimp *jimp);
+#endif
 
 /// If succeeds puts the freshly parsed boolean into jimp->boolean.
 /// Any consequent calls to the jimp_* functions may invalidate jimp->boolean.
@@ -79,15 +284,41 @@ bool jimp_bool(Jimp *jimp);
 /// Any consequent calls to the jimp_* functions may invalidate jimp->number.
 bool jimp_number(Jimp *jimp);
 
+/// Like jimp_number, but fails unless the number is an integer (no fraction or
+/// exponent). If succeeds puts it into jimp->integer.
+bool jimp_integer(Jimp *jimp);
+
 /// If succeeds puts the freshly parsed string into jimp->string as a NULL-terminated string.
 /// Any consequent calls to the jimp_* functions may invalidate jimp->string.
 /// strdup it if you don't wanna lose it (memory management is on you at that point).
 bool jimp_string(Jimp *jimp);
 
+#define JIMP_HASH_OFFSET 2166136261u
+#define JIMP_HASH_PRIME 16777619u
+
+static constexpr uint32_t jimp__hash_step(uint32_t hash, char x)
+{
+    return (hash ^ (unsigned char)x) * JIMP_HASH_PRIME;
+}
+
+/// FNV-1a hash of s. It matches jimp->hash after a string was parsed, so it can
+/// be used in case labels to dispatch on object members:
+///
+///     switch (jimp->hash) {
+///     case jimp_hash("name"): ...
+///
+/// Duplicate case labels do not compile, so a hash collision between two keys of
+/// the same object is caught at compile time.
+static constexpr uint32_t jimp_hash(const char *s, uint32_t hash = JIMP_HASH_OFFSET)
+{
+    return *s ? jimp_hash(s + 1, jimp__hash_step(hash, *s)) : hash;
+}
+
 /// Parses the beginning of the object `{`
 bool jimp_object_begin(Jimp *jimp);
 
-/// If succeeds puts the key of the member into jimp->string as a NULL-terminated string.
+/// If succeeds puts the key of the member into jimp->string as a NULL-terminated string
+/// and its jimp_hash into jimp->hash.
 /// Any consequent calls to the jimp_* functions may invalidate jimp->string.
 /// strdup it if you don't wanna lose it (memory management is on you at that point).
 bool jimp_object_member(Jimp *jimp);
@@ -99,6 +330,10 @@ bool jimp_object_end(Jimp *jimp);
 /// jimp_object_member.
 void jimp_unknown_member(Jimp *jimp);
 
+/// Counts jimp->string as a member the caller didn't expect but is going to skip
+/// anyway. Only the first one of a parse gets reported.
+void jimp_unexpected_member(Jimp *jimp);
+
 /// Parses the beginning of the array `[`
 bool jimp_array_begin(Jimp *jimp);
 
@@ -112,11 +347,188 @@ bool jimp_skip_array(Jimp *jimp);
 bool jimp_skip_object(Jimp *jimp);
 bool jimp_skip_any(Jimp *jimp);
 
+/// Skips the rest of the count innermost containers the parser is in, up to and
+/// including their closing brackets.
+bool jimp_skip_enclosing(Jimp *jimp, int count);
+
 /// Prints diagnostic at the current position of the parser.
 void jimp_diagf_(int const line, const char *fmt, ...);
 
 #define jimp_diagf(args...) jimp_diagf_(__LINE__, args)
 
+/// Starts a push mode parse: instead of jimp pulling bytes from a source, the
+/// caller hands it chunks with arbitrary boundaries through jimp_push_feed and
+/// handler gets called for every value. jimp_push_feed never waits for input,
+/// so parsing can be interleaved with receiving.
+void jimp_push_begin(Jimp *jimp, Jimp_Handler handler, void * user_data = nullptr);
+
+/// Parses size bytes at data. The data is not referenced after the call returns.
+/// Once the parse is done or failed, further input is ignored.
+Jimp_Push_Status jimp_push_feed(Jimp *jimp, const char *data, size_t size);
+
+#ifdef ARDUINO
+/// Feeds whatever stream has available without waiting for more.
+Jimp_Push_Status jimp_push_poll(Jimp *jimp, Stream &stream);
+#endif
+
+/// Tells the parser that there is no more input. Fails unless the top-level
+/// value is complete.
+Jimp_Push_Status jimp_push_end(Jimp *jimp);
+
+/// Called by a handler on a MEMBER or scalar event: once the handler returns
+/// JIMP_CONTINUE, the rest of the count innermost containers is skipped. No
+/// events are delivered for them, not even their END. Leaving the top-level
+/// value completes the parse.
+void jimp_push_skip_enclosing(Jimp *jimp, uint8_t count);
+
+// Path projection. A set of selectors like
+//
+//     serverInfo.serverTime
+//     stopEvents[*].location.properties.platform
+//
+// is compiled into a trie, which a push mode handler walks along with the
+// document. Values at the end of a selector go to a sink, every other member
+// and array element is skipped by the raw scanner without looking at it. A
+// selector is a chain of member names separated by `.` and `[*]` for every
+// element of an array. Names can't contain `.` or `[`.
+
+#define JIMP_PATH_MAX_NODES 32
+
+typedef struct {
+    // jimp_hash of the member name, unless this is a [*] step.
+    uint32_t hash;
+    // The member name, in the selector it came from. The hash only rules
+    // names out; a hit still has to compare them.
+    const char *name;
+    uint8_t length;
+    uint8_t parent;
+    bool element;
+    // Index of the selector that ends here, or -1.
+    int8_t selector;
+} Jimp_Path_Node;
+
+typedef struct {
+    // nodes[0] is the top-level value.
+    Jimp_Path_Node nodes[JIMP_PATH_MAX_NODES];
+    uint8_t count;
+    // Index of the first selector that didn't compile, or -1.
+    int8_t invalid;
+} Jimp_Paths;
+
+static constexpr bool jimp__paths_name_is(Jimp_Path_Node const &node, uint32_t hash, const char *name, size_t length)
+{
+    if (node.hash != hash || node.length != length) return false;
+    for (size_t i = 0; i < length; ++i) {
+        if (node.name[i] != name[i]) return false;
+    }
+    return true;
+}
+
+// The child of parent for the member name, or the [*] child if element.
+static constexpr uint8_t jimp__paths_child(const Jimp_Paths *paths, uint8_t parent, bool element,
+    uint32_t hash, const char *name, size_t length)
+{
+    for (uint8_t i = 1; i < paths->count; ++i) {
+        Jimp_Path_Node const &node = paths->nodes[i];
+        if (node.parent == parent && node.element == element
+            && (element || jimp__paths_name_is(node, hash, name, length))) return i;
+    }
+    return 0;
+}
+
+static constexpr bool jimp__paths_add(Jimp_Paths *paths, const char *selector, int8_t index)
+{
+    uint8_t node = 0;
+    const char *p = selector;
+    if (*p == '\0') return false;
+
+    while (*p) {
+        bool element = false;
+        uint32_t hash = JIMP_HASH_OFFSET;
+        const char *name = nullptr;
+        size_t length = 0;
+        if (*p == '[') {
+            if (p[1] != '*' || p[2] != ']') return false;
+            element = true;
+            p += 3;
+        } else {
+            if (p != selector && *p++ != '.') return false;
+            name = p;
+            while (*p && *p != '.' && *p != '[') hash = jimp__hash_step(hash, *p++);
+            length = (size_t)(p - name);
+            if (length == 0 || length > UINT8_MAX) return false;
+        }
+
+        uint8_t child = jimp__paths_child(paths, node, element, hash, name, length);
+        if (child == 0) {
+            if (paths->count == JIMP_PATH_MAX_NODES) return false;
+            child = paths->count++;
+            paths->nodes[child] = Jimp_Path_Node{hash, name, (uint8_t)length, node, element, -1};
+        }
+        node = child;
+    }
+
+    if (paths->nodes[node].selector != -1) return false;
+    paths->nodes[node].selector = index;
+    return true;
+}
+
+/// Compiles count selectors into paths. Fails if one of them is malformed or
+/// a duplicate, or if they need more than JIMP_PATH_MAX_NODES steps in total.
+/// paths points into the selectors, which have to outlive it. Usable in
+/// constant expressions, see jimp_paths.
+static constexpr bool jimp_paths_compile(Jimp_Paths *paths, const char *const *selectors, size_t count)
+{
+    *paths = Jimp_Paths{};
+    paths->nodes[0].selector = -1;
+    paths->count = 1;
+    paths->invalid = -1;
+    for (size_t i = 0; i < count; ++i) {
+        if (!jimp__paths_add(paths, selectors[i], (int8_t)i)) {
+            paths->invalid = (int8_t)i;
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Compiles selectors at compile time, so the result can live in flash:
+///
+///     static constexpr const char *selectors[] = {"serverInfo.serverTime", ...};
+///     static constexpr Jimp_Paths paths = jimp_paths(selectors);
+///     static_assert(paths.invalid == -1, "bad selector");
+template <size_t N>
+constexpr Jimp_Paths jimp_paths(const char *const (&selectors)[N])
+{
+    Jimp_Paths paths = {};
+    jimp_paths_compile(&paths, selectors, N);
+    return paths;
+}
+
+/// Gets the values selected by selector. A scalar comes as a single event. A
+/// selected object or array comes as all of its events, from its BEGIN to its
+/// END, which includes anything that other selectors below it would select.
+/// The return value works as for a Jimp_Handler.
+typedef Jimp_Action (*Jimp_Path_Sink)(Jimp *jimp, Jimp_Event event, int selector, void *user_data);
+
+// Where the handler is in the document, see jimp_paths_begin.
+typedef struct {
+    const Jimp_Paths *paths;
+    Jimp_Path_Sink sink;
+    void *user_data;
+    // Node of the container at each depth.
+    uint8_t nodes[JIMP_PUSH_MAX_DEPTH];
+    // Node of the member that was just read.
+    uint8_t member;
+    // The selected container we are in, if capture != -1.
+    int8_t capture;
+    uint8_t capture_depth;
+} Jimp_Path_Match;
+
+/// Starts a push mode parse that hands the values selected by paths to sink.
+/// Feed it like any other push mode parse. paths and match must outlive it.
+void jimp_paths_begin(Jimp *jimp, Jimp_Path_Match *match, const Jimp_Paths *paths, Jimp_Path_Sink sink, void *user_data = nullptr);
+
 bool jimp_is_null_ahead(Jimp *jimp);
 bool jimp_is_bool_ahead(Jimp *jimp);
 bool jimp_is_number_ahead(Jimp *jimp);
@@ -128,82 +540,487 @@ bool jimp_is_object_ahead(Jimp *jimp);
 
 #ifdef JIMP_IMPLEMENTATION
 
+#if JIMP_SCAN >= JIMP_SCAN_SSE2
+#include <immintrin.h>
+#endif
+
 static bool jimp__expect_token(Jimp *jimp, Jimp_Token token);
 static bool jimp__get_and_expect_token(Jimp *jimp, Jimp_Token token);
 static const char *jimp__token_kind(Jimp_Token token);
 static bool jimp__get_token(Jimp *jimp);
 static bool jimp__parse_number(Jimp *jimp);
 static void jimp__skip_whitespaces(Jimp *jimp);
-static bool jimp__skip_open_container(Jimp *jimp, Jimp_Token openToken, Jimp_Token closeToken);
+static bool jimp__skip_raw(Jimp *jimp, int depth, bool in_string);
+static bool jimp__skip_open_container(Jimp *jimp, Jimp_Token closeToken);
 static void jimp__append_to_string(Jimp *jimp, char x);
 
+#if JIMP_STATS
+#define JIMP__STATS(statement) do { statement; } while (0)
+
+static uint32_t jimp__micros()
+{
+#ifdef ARDUINO
+    return micros();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+#endif
+}
+#else
+#define JIMP__STATS(statement) do {} while (0)
+#endif
+
+static void jimp__begin_string(Jimp *jimp)
+{
+    jimp->string_count = 0;
+    jimp->truncated = false;
+}
+
 static void jimp__append_to_string(Jimp *jimp, char x)
 {
-    if (jimp->string_count >= jimp->string_capacity) {
+    // Always keep room for the NULL-terminator.
+    if (jimp->string_count + 1 >= jimp->string_capacity) {
+        if (jimp->overflow != JIMP_OVERFLOW_GROW) {
+            jimp->truncated = true;
+            return;
+        }
         if (jimp->string_capacity == 0) jimp->string_capacity = 1024;
         else jimp->string_capacity *= 2;
         jimp->string = (char*)realloc(jimp->string, jimp->string_capacity);
     }
     jimp->string[jimp->string_count++] = x;
+    JIMP__STATS(jimp->stats.bytes_materialized++);
 }
 
-// TODO It will just wait forever if we expect more bytes and the stream doesn't
-// give tyem.
-static int jimp__peek(Jimp *jimp) {
-    if (jimp->last_char != -1) {
-        return jimp->last_char;
+// NULL-terminates jimp->string and applies the overflow policy.
+static bool jimp__end_string(Jimp *jimp)
+{
+    if (jimp->string_capacity == 0) {
+        jimp__append_to_string(jimp, '\0');
+        jimp->string_count = 0;
     }
-#ifdef ARDUINO
-    while (jimp->stream->available() <= 0) {
-        delay(1);
+    jimp->string[jimp->string_count] = '\0';
+#if JIMP_STATS
+    size_t used = jimp->truncated ? jimp->string_capacity : jimp->string_count + 1;
+    if (used > jimp->stats.peak_string) jimp->stats.peak_string = used;
+#endif
+    if (jimp->truncated && jimp->overflow == JIMP_OVERFLOW_ERROR) {
+        jimp_diagf("ERROR: token longer than %u bytes\n", (unsigned)(jimp->string_capacity - 1));
+        return false;
     }
-    jimp->last_char = jimp->stream->read();
+    return true;
+}
+
+// Appends a character of a string token and folds it into jimp->hash.
+static inline void jimp__append_to_key(Jimp *jimp, char x)
+{
+    jimp->hash = jimp__hash_step(jimp->hash, x);
+    jimp__append_to_string(jimp, x);
+}
+
+// Same as jimp__append_to_key for n characters at once.
+static void jimp__append_run_to_key(Jimp *jimp, const char *run, size_t n)
+{
+    uint32_t hash = jimp->hash;
+    for (size_t i = 0; i < n; ++i) hash = jimp__hash_step(hash, run[i]);
+    jimp->hash = hash;
+
+    // Always keep room for the NULL-terminator.
+    if (jimp->overflow == JIMP_OVERFLOW_GROW) {
+        while (jimp->string_count + n + 1 > jimp->string_capacity) {
+            if (jimp->string_capacity == 0) jimp->string_capacity = 1024;
+            else jimp->string_capacity *= 2;
+            jimp->string = (char*)realloc(jimp->string, jimp->string_capacity);
+        }
+    } else {
+        size_t room = jimp->string_capacity > jimp->string_count + 1
+            ? jimp->string_capacity - jimp->string_count - 1 : 0;
+        if (n > room) {
+            n = room;
+            jimp->truncated = true;
+        }
+    }
+    memcpy(jimp->string + jimp->string_count, run, n);
+    jimp->string_count += n;
+    JIMP__STATS(jimp->stats.bytes_materialized += n);
+}
+
+// Refill the input chunk from the stream. Only called when the chunk is used
+// up. Returns the next byte without consuming it or -1 at the end of input.
+static int jimp__refill(Jimp *jimp) {
+    if (jimp->eof) return -1;
+#if JIMP_STATS
+    uint32_t started = jimp__micros();
+    jimp->stats.parse_us += started - jimp->stats.refilled_us;
+#endif
+#ifdef ARDUINO
+    // Take everything that is already decoded, but at least one byte. If there
+    // is nothing yet, readBytes waits for the stream's timeout (yielding to the
+    // network stack) instead of us spinning on available().
+    int available = jimp->stream->available();
+    size_t want = available > 0 ? (size_t)available : 1;
+    if (want > sizeof(jimp->input)) want = sizeof(jimp->input);
+    size_t n = jimp->stream->readBytes(jimp->input, want);
 #else
-    jimp->last_char = jimp->buffer[++jimp->offset];
+    ssize_t n = 0;
+    if (jimp->fd >= 0) {
+        do {
+            n = read(jimp->fd, jimp->input, sizeof(jimp->input));
+        } while (n < 0 && errno == EINTR);
+    }
+    if (n < 0) {
+        jimp_diagf("ERROR: read failed: %s\n", strerror(errno));
+        n = 0;
+    }
 #endif
-    return jimp->last_char;
+#if JIMP_STATS
+    jimp->stats.refilled_us = jimp__micros();
+    jimp->stats.wait_us += jimp->stats.refilled_us - started;
+    jimp->stats.bytes += n;
+#endif
+    if (n == 0) {
+        jimp->eof = true;
+        return -1;
+    }
+    jimp->cursor = jimp->input;
+    jimp->end = jimp->input + n;
+    return (unsigned char)*jimp->cursor;
 }
 
-static int jimp__get(Jimp *jimp) {
+static inline int jimp__peek(Jimp *jimp) {
+    if (jimp->cursor != jimp->end) return (unsigned char)*jimp->cursor;
+    return jimp__refill(jimp);
+}
+
+static inline int jimp__get(Jimp *jimp) {
     int c = jimp__peek(jimp);
-    jimp->last_char = -1;
+    if (c != -1) jimp->cursor++;
     return c;
 }
 
+// The kind argument of the scan kernels is always a constant, so make sure it
+// gets folded away.
+#define JIMP__ALWAYS_INLINE inline __attribute__((always_inline))
+
+// What jimp__scan stops at.
+typedef enum {
+    // '"' and '\\', the end of a run of plain string characters
+    JIMP__SCAN_STRING,
+    // '"', '{', '}', '[' and ']', the bytes that matter while skipping a value
+    JIMP__SCAN_STRUCTURAL,
+    // Anything that is not JSON whitespace
+    JIMP__SCAN_WHITESPACE,
+} Jimp__Scan;
+
+static JIMP__ALWAYS_INLINE bool jimp__scan_stop(char c, Jimp__Scan kind)
+{
+    switch (kind) {
+    case JIMP__SCAN_STRING:
+        return c == '"' || c == '\\';
+    case JIMP__SCAN_STRUCTURAL:
+        return c == '"' || c == '{' || c == '}' || c == '[' || c == ']';
+    case JIMP__SCAN_WHITESPACE:
+        return !(c == ' ' || c == '\n' || c == '\r' || c == '\t');
+    }
+    return true;
+}
+
+#if JIMP_SCAN == JIMP_SCAN_SWAR
+// SWAR: treat a machine word as a vector of bytes.
+typedef uintptr_t jimp__word;
+#define JIMP__WORD_ONES ((jimp__word)-1 / 0xFF)
+#define JIMP__WORD_HIGHS (JIMP__WORD_ONES * 0x80)
+
+// High bit of every byte of v that equals b. Exact, no carries between bytes.
+static JIMP__ALWAYS_INLINE jimp__word jimp__swar_eq(jimp__word v, unsigned char b)
+{
+    jimp__word t = v ^ (JIMP__WORD_ONES * b);
+    return ~(((t & ~JIMP__WORD_HIGHS) + ~JIMP__WORD_HIGHS) | t) & JIMP__WORD_HIGHS;
+}
+
+static JIMP__ALWAYS_INLINE jimp__word jimp__swar_stop(jimp__word v, Jimp__Scan kind)
+{
+    switch (kind) {
+    case JIMP__SCAN_STRING:
+        return jimp__swar_eq(v, '"') | jimp__swar_eq(v, '\\');
+    case JIMP__SCAN_STRUCTURAL: {
+        // Setting bit 5 turns '[' into '{' and ']' into '}' and nothing else
+        // into either of them.
+        jimp__word folded = v | (JIMP__WORD_ONES * 0x20);
+        return jimp__swar_eq(v, '"') | jimp__swar_eq(folded, '{') | jimp__swar_eq(folded, '}');
+    }
+    case JIMP__SCAN_WHITESPACE:
+        return ~(jimp__swar_eq(v, ' ') | jimp__swar_eq(v, '\n') |
+                 jimp__swar_eq(v, '\r') | jimp__swar_eq(v, '\t')) & JIMP__WORD_HIGHS;
+    }
+    return JIMP__WORD_HIGHS;
+}
+#endif
+
+#if JIMP_SCAN >= JIMP_SCAN_SSE2
+static JIMP__ALWAYS_INLINE unsigned jimp__sse2_stop(__m128i v, Jimp__Scan kind)
+{
+    switch (kind) {
+    case JIMP__SCAN_STRING:
+        return (unsigned)_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+    case JIMP__SCAN_STRUCTURAL: {
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        return (unsigned)_mm_movemask_epi8(_mm_or_si128(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+            _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                         _mm_cmpeq_epi8(folded, _mm_set1_epi8('}')))));
+    }
+    case JIMP__SCAN_WHITESPACE:
+        return ~(unsigned)_mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))))) & 0xFFFF;
+    }
+    return 0xFFFF;
+}
+#endif
+
+#if JIMP_SCAN == JIMP_SCAN_AVX2
+static JIMP__ALWAYS_INLINE uint32_t jimp__avx2_stop(__m256i v, Jimp__Scan kind)
+{
+    switch (kind) {
+    case JIMP__SCAN_STRING:
+        return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+    case JIMP__SCAN_STRUCTURAL: {
+        __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+                            _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}')))));
+    }
+    case JIMP__SCAN_WHITESPACE:
+        return ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')))));
+    }
+    return 0xFFFFFFFF;
+}
+#endif
+
+#if JIMP_SCAN >= JIMP_SCAN_SSE2
+// Bit masks of the interesting bytes in a block of 64 bytes.
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t open;
+    uint64_t close;
+} Jimp__Block;
+
+static JIMP__ALWAYS_INLINE void jimp__classify_block(const char *p, Jimp__Block *block)
+{
+#if JIMP_SCAN == JIMP_SCAN_AVX2
+    block->quote = block->backslash = block->open = block->close = 0;
+    for (int i = 0; i < 64; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        block->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << i;
+        block->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << i;
+        block->open |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{'))) << i;
+        block->close |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))) << i;
+    }
+#else
+    block->quote = block->backslash = block->open = block->close = 0;
+    for (int i = 0; i < 64; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        block->quote |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << i;
+        block->backslash |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << i;
+        block->open |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{'))) << i;
+        block->close |= (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))) << i;
+    }
+#endif
+}
+
+// Bit i of the result is the xor of bits 0..i of x. Applied to the quote mask
+// this marks the bytes that are inside a string.
+static JIMP__ALWAYS_INLINE uint64_t jimp__prefix_xor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+#endif
+
+// Returns the first byte in [p, end) that kind stops at, or end.
+static JIMP__ALWAYS_INLINE const char *jimp__scan(const char *p, const char *end, Jimp__Scan kind)
+{
+#if JIMP_SCAN == JIMP_SCAN_AVX2
+    for (; end - p >= 32; p += 32) {
+        uint32_t mask = jimp__avx2_stop(_mm256_loadu_si256((const __m256i *)p), kind);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+#if JIMP_SCAN >= JIMP_SCAN_SSE2
+    for (; end - p >= 16; p += 16) {
+        unsigned mask = jimp__sse2_stop(_mm_loadu_si128((const __m128i *)p), kind);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+#endif
+#if JIMP_SCAN == JIMP_SCAN_SWAR
+    // Unaligned word loads trap on the ESP8266, so get p aligned first.
+    for (; p < end && ((uintptr_t)p % sizeof(jimp__word)) != 0; ++p) {
+        if (jimp__scan_stop(*p, kind)) return p;
+    }
+    for (; end - p >= (ptrdiff_t)sizeof(jimp__word); p += sizeof(jimp__word)) {
+        jimp__word v;
+        memcpy(&v, __builtin_assume_aligned(p, sizeof(jimp__word)), sizeof(v));
+        // The byte is found by the scalar loop below.
+        if (jimp__swar_stop(v, kind)) break;
+    }
+#endif
+    for (; p < end; ++p) {
+        if (jimp__scan_stop(*p, kind)) return p;
+    }
+    return end;
+}
+
 static void jimp__skip_whitespaces(Jimp *jimp) {
-    int c;
-    while ((c = jimp__peek(jimp)) >= 0 && isspace(c)) {
-        jimp__get(jimp);
+    while (true) {
+        jimp->cursor = jimp__scan(jimp->cursor, jimp->end, JIMP__SCAN_WHITESPACE);
+        if (jimp->cursor != jimp->end) return;
+        if (jimp__refill(jimp) == -1) return;
     }
 }
 
+static bool jimp__is_number_char(char c)
+{
+    return isdigit((unsigned char)c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+// Integers are accumulated directly as they are read. Only numbers with a
+// fraction or an exponent, or too many digits for an int64_t, are collected in
+// jimp->string for strtod, which is slow on the soft-float ESP8266.
+static void jimp__begin_number(Jimp *jimp)
+{
+    jimp__begin_string(jimp);
+    jimp->number_value = 0;
+    jimp->number_digits = 0;
+    jimp->number_negative = false;
+    jimp->number_text = false;
+}
+
+// Switches the number being read over to strtod.
+static void jimp__number_to_text(Jimp *jimp)
+{
+    jimp->number_text = true;
+    if (jimp->number_negative) jimp__append_to_string(jimp, '-');
+    if (jimp->number_digits == 0) return;
+
+    char digits[20];
+    int n = 0;
+    uint64_t value = jimp->number_value;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n) jimp__append_to_string(jimp, digits[--n]);
+}
+
+// Feeds the next character of a number. Returns false if c is not part of it.
+static bool jimp__number_char(Jimp *jimp, char c)
+{
+    if (!jimp->number_text) {
+        if (c >= '0' && c <= '9' && jimp->number_digits < 18) {
+            jimp->number_value = jimp->number_value * 10 + (c - '0');
+            jimp->number_digits++;
+            return true;
+        }
+        if (!jimp__is_number_char(c)) return false;
+        if (c == '-' && jimp->number_digits == 0 && !jimp->number_negative) {
+            jimp->number_negative = true;
+            return true;
+        }
+        jimp__number_to_text(jimp);
+    }
+    if (!jimp__is_number_char(c)) return false;
+    jimp__append_to_string(jimp, c);
+    return true;
+}
+
+static bool jimp__end_number(Jimp *jimp)
+{
+    if (!jimp->number_text) {
+        if (jimp->number_digits == 0) {
+            jimp_diagf("ERROR: invalid number\n");
+            return false;
+        }
+        jimp->integer = jimp->number_negative
+            ? -(int64_t)jimp->number_value : (int64_t)jimp->number_value;
+        jimp->number = (double)jimp->integer;
+        jimp->is_integer = true;
+        return true;
+    }
+
+    if (!jimp__end_string(jimp)) return false;
+    char *end;
+    jimp->number = strtod(jimp->string, &end);
+    if (end == jimp->string || *end != '\0') {
+        jimp_diagf("ERROR: invalid number\n");
+        return false;
+    }
+    jimp->is_integer = false;
+    return true;
+}
+
 static bool jimp__parse_number(Jimp *jimp) {
     // jimp__skip_whitespaces(jimp);
-    jimp->string_count = 0;
+    jimp__begin_number(jimp);
     int c = jimp__peek(jimp);
 
-    if (-1 == c) return false;
-
-    bool found = false;
+    if (-1 == c || !jimp__is_number_char((char)c)) return false;
 
-    while (isdigit(c) || c == '-' || c == '+' || c == '.') {
-        jimp__append_to_string(jimp, (char)c);
-        found = true;
+    while (c != -1 && jimp__number_char(jimp, (char)c)) {
         jimp__get(jimp);
         c = jimp__peek(jimp);
     }
 
-    if (found) {
-        jimp__append_to_string(jimp, '\0');
-        jimp->number = strtod(jimp->string, NULL);
-    }
+    return jimp__end_number(jimp);
+}
 
-    return found;
+// Token of every punctuation character, JIMP_INVALID for the rest. Read with
+// jimp__punct: on the ESP8266 the table lives in flash, which only allows
+// aligned 32 bit reads.
+struct Jimp__Puncts {
+    uint8_t tokens[256];
+};
+
+static constexpr Jimp__Puncts jimp__make_puncts()
+{
+    Jimp__Puncts puncts = {};
+    puncts.tokens['{'] = JIMP_OCURLY;
+    puncts.tokens['}'] = JIMP_CCURLY;
+    puncts.tokens['['] = JIMP_OBRACKET;
+    puncts.tokens[']'] = JIMP_CBRACKET;
+    puncts.tokens[','] = JIMP_COMMA;
+    puncts.tokens[':'] = JIMP_COLON;
+    return puncts;
 }
 
-static Jimp_Token jimp__puncts[256] = {};
+static constexpr Jimp__Puncts jimp__puncts PROGMEM = jimp__make_puncts();
+
+static inline Jimp_Token jimp__punct(char c)
+{
+    return (Jimp_Token)pgm_read_byte(&jimp__puncts.tokens[(unsigned char)c]);
+}
 
-static struct {
+static constexpr struct {
     Jimp_Token token;
     const char *symbol;
 } jimp__symbols[] = {
@@ -213,6 +1030,22 @@ static struct {
 };
 #define jimp__symbols_count (sizeof(jimp__symbols)/sizeof(jimp__symbols[0]))
 
+// The character that the escape sequence \\c stands for or -1.
+static int jimp__unescape(char c)
+{
+    switch (c) {
+    case 'r':  return '\r';
+    case 'n':  return '\n';
+    case 't':  return '\t';
+    case 'b':  return '\b';
+    case 'f':  return '\f';
+    case '/':  return '/';
+    case '\\': return '\\';
+    case '"':  return '"';
+    }
+    return -1;
+}
+
 static bool jimp__get_token(Jimp *jimp)
 {
     jimp__skip_whitespaces(jimp);
@@ -221,7 +1054,8 @@ static bool jimp__get_token(Jimp *jimp)
 
     if (-1 == c) return false;
 
-    jimp->token = jimp__puncts[(unsigned char)c];
+    JIMP__STATS(jimp->stats.tokens++);
+    jimp->token = jimp__punct((char)c);
 
     if (jimp->token) {
         jimp__get(jimp);
@@ -249,9 +1083,18 @@ static bool jimp__get_token(Jimp *jimp)
 
     if ('"' == (char)c) {
         jimp__get(jimp);
-        jimp->string_count = 0;
+        jimp__begin_string(jimp);
+        jimp->hash = JIMP_HASH_OFFSET;
 
         while (true) {
+            // Copy the plain characters up to the next quote or backslash in
+            // one go.
+            const char *run = jimp__scan(jimp->cursor, jimp->end, JIMP__SCAN_STRING);
+            if (run != jimp->cursor) {
+                jimp__append_run_to_key(jimp, jimp->cursor, run - jimp->cursor);
+                jimp->cursor = run;
+            }
+
             int c = jimp__get(jimp);
             if (c == -1) {
                 jimp->token = JIMP_INVALID;
@@ -262,48 +1105,31 @@ static bool jimp__get_token(Jimp *jimp)
             // Yes, including those dumb suroggate pairs. Spec is spec.
             switch ((char)c) {
             case '\\': {
-                jimp__get(jimp);
                 if (jimp__peek(jimp) == -1)
                 {
                     jimp->token = JIMP_INVALID;
                     jimp_diagf("ERROR: unfinished escape sequence\n");
                     return false;
                 }
-                switch ((char)jimp__peek(jimp)) {
-                case 'r':
-                    jimp__get(jimp);
-                    jimp__append_to_string(jimp, '\r');
-                    break;
-                case 'n':
-                    jimp__get(jimp);
-                    jimp__append_to_string(jimp, '\n');
-                    break;
-                case 't':
-                    jimp__get(jimp);
-                    jimp__append_to_string(jimp, '\t');
-                    break;
-                case '\\':
-                    jimp__get(jimp);
-                    jimp__append_to_string(jimp, '\\');
-                    break;
-                case '"':
-                    jimp__get(jimp);
-                    jimp__append_to_string(jimp, '"');
-                    break;
-                default:
+                int unescaped = jimp__unescape((char)jimp__get(jimp));
+                if (unescaped == -1) {
                     jimp->token = JIMP_INVALID;
                     jimp_diagf("ERROR: invalid escape sequence\n");
                     return false;
                 }
+                jimp__append_to_key(jimp, (char)unescaped);
                 break;
             }
             case '"': {
-                jimp__append_to_string(jimp, '\0');
+                if (!jimp__end_string(jimp)) {
+                    jimp->token = JIMP_INVALID;
+                    return false;
+                }
                 jimp->token = JIMP_STRING;
                 return true;
             }
             default: {
-                jimp__append_to_string(jimp, (char)c);
+                jimp__append_to_key(jimp, (char)c);
             }
             }
         }
@@ -321,26 +1147,99 @@ static bool jimp__get_token(Jimp *jimp)
     return false;
 }
 
-void jimp_begin(Jimp *jimp, Stream &stream, void * user_data)
+static void jimp__begin(Jimp *jimp, void * user_data)
 {
-    // Initialize here for c++ support (c++ doesn't have array designated
-    // initializers)
-    jimp__puncts['{'] = JIMP_OCURLY,
-    jimp__puncts['}'] = JIMP_CCURLY,
-    jimp__puncts['['] = JIMP_OBRACKET,
-    jimp__puncts[']'] = JIMP_CBRACKET,
-    jimp__puncts[','] = JIMP_COMMA,
-    jimp__puncts[':'] = JIMP_COLON,
+    jimp->eof = false;
+    jimp->cursor = jimp->input;
+    jimp->end = jimp->input;
+    jimp->unexpected_members = 0;
+    jimp->stopped = false;
+#if JIMP_STATS
+    memset(&jimp->stats, 0, sizeof(jimp->stats));
+    jimp->stats.refilled_us = jimp__micros();
+#endif
+
+    jimp->user_data = user_data;
+}
 
 #ifdef ARDUINO
+void jimp_begin(Jimp *jimp, Stream &stream, void * user_data)
+{
+    jimp__begin(jimp, user_data);
     jimp->stream = &stream;
+}
 #else
-    jimp->buffer = data;
-    jimp->offset = -1;
+void jimp_begin_memory(Jimp *jimp, const char *data, size_t size, void * user_data)
+{
+    jimp__begin(jimp, user_data);
+    jimp->fd = -1;
+    jimp->mapping = NULL;
+    jimp->mapping_size = 0;
+    jimp->cursor = data;
+    jimp->end = data + size;
+    JIMP__STATS(jimp->stats.bytes = size);
+}
+
+void jimp_begin_fd(Jimp *jimp, int fd, void * user_data)
+{
+    jimp__begin(jimp, user_data);
+    jimp->fd = fd;
+    jimp->mapping = NULL;
+    jimp->mapping_size = 0;
+}
+
+bool jimp_begin_mmap(Jimp *jimp, const char *path, void * user_data)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        jimp_diagf("ERROR: could not open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        jimp_diagf("ERROR: could not stat %s: %s\n", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *mapping = NULL;
+    if (size > 0) {
+        mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            jimp_diagf("ERROR: could not mmap %s: %s\n", path, strerror(errno));
+            close(fd);
+            return false;
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+    }
+    // The mapping stays valid after the fd is closed.
+    close(fd);
+
+    jimp_begin_memory(jimp, (const char *)mapping, size, user_data);
+    jimp->mapping = mapping;
+    jimp->mapping_size = size;
+    return true;
+}
+
+void jimp_end(Jimp *jimp)
+{
+    if (jimp->mapping) munmap(jimp->mapping, jimp->mapping_size);
+    jimp->mapping = NULL;
+    jimp->mapping_size = 0;
+    jimp->cursor = jimp->end = jimp->input;
+    jimp->eof = true;
+}
 #endif
-    jimp->last_char = -1;
 
-    jimp->user_data = user_data;
+void jimp_arena(Jimp *jimp, char *arena, size_t size, Jimp_Overflow overflow)
+{
+    assert(size > 0);
+    jimp->string = arena;
+    jimp->string_capacity = size;
+    jimp->string_count = 0;
+    jimp->overflow = overflow;
 }
 
 void jimp_diagf_(int const line, const char *fmt, ...)
@@ -424,6 +1323,14 @@ void jimp_unknown_member(Jimp *jimp)
     jimp_diagf("\n\n[ERROR]: unexpected object member `%s`\n\n", jimp->string);
 }
 
+void jimp_unexpected_member(Jimp *jimp)
+{
+    if (jimp->unexpected_members == 0) {
+        jimp_diagf("WARNING: skipping unexpected object member `%s`\n", jimp->string);
+    }
+    if (jimp->unexpected_members < UINT16_MAX) jimp->unexpected_members++;
+}
+
 bool jimp_object_begin(Jimp *jimp)
 {
     return jimp__get_and_expect_token(jimp, JIMP_OCURLY);
@@ -484,6 +1391,16 @@ bool jimp_number(Jimp *jimp)
     return jimp__get_and_expect_token(jimp, JIMP_NUMBER);
 }
 
+bool jimp_integer(Jimp *jimp)
+{
+    if (!jimp_number(jimp)) return false;
+    if (!jimp->is_integer) {
+        jimp_diagf("ERROR: expected integer, but got %s\n", jimp->string);
+        return false;
+    }
+    return true;
+}
+
 bool jimp_is_null_ahead(Jimp *jimp) {
     jimp__skip_whitespaces(jimp);
     int c = jimp__peek(jimp);
@@ -532,39 +1449,145 @@ static bool jimp__expect_token(Jimp *jimp, Jimp_Token token)
     return true;
 }
 
-static bool jimp__skip_open_container(Jimp *jimp, Jimp_Token openToken, Jimp_Token closeToken) {
-    int depth = 1;
-
-    while (true) {
-        if (!jimp__get_token(jimp)) return false;
-
-        if (jimp->token == openToken) {
+// Consumes raw bytes from [p, end) until skip->depth containers have been
+// closed and we are not inside a string. Only nesting, string and escape state
+// are tracked: nothing is copied into jimp->string, numbers are not converted,
+// and brackets are not matched against each other. Skipped content is therefore
+// not validated. Returns where it stopped; *done tells whether the skip is
+// complete or needs more input.
+static const char *jimp__skip_chunk(Jimp_Push *skip, const char *p, const char *end, bool *done)
+{
+    int depth = skip->skip_depth;
+    bool in_string = skip->skip_in_string;
+    bool escaped = skip->skip_escaped;
+    *done = false;
+
+    while (p < end) {
+        if (escaped) {
+            escaped = false;
+            ++p;
+            continue;
+        }
+#if JIMP_SCAN >= JIMP_SCAN_SSE2
+        // Skip whole blocks as long as the container cannot close inside of
+        // them. Blocks with escapes are left to the byte loop below.
+        if (end - p >= 64) {
+            Jimp__Block block;
+            jimp__classify_block(p, &block);
+            if (block.backslash == 0) {
+                uint64_t strings = jimp__prefix_xor(block.quote);
+                if (in_string) strings = ~strings;
+                int opens = __builtin_popcountll(block.open & ~strings);
+                int closes = __builtin_popcountll(block.close & ~strings);
+                if (depth > closes) {
+                    depth += opens - closes;
+                    in_string ^= __builtin_popcountll(block.quote) & 1;
+                    p += 64;
+                    continue;
+                }
+            }
+        }
+#endif
+        if (in_string) {
+            p = jimp__scan(p, end, JIMP__SCAN_STRING);
+            if (p == end) break;
+            if (*p++ == '\\') {
+                escaped = true;
+                continue;
+            }
+            in_string = false;
+            if (depth == 0) {
+                *done = true;
+                break;
+            }
+            continue;
+        }
+        p = jimp__scan(p, end, JIMP__SCAN_STRUCTURAL);
+        if (p == end) break;
+        switch (*p++) {
+        case '"':
+            in_string = true;
+            break;
+        case '{':
+        case '[':
             depth++;
+            break;
+        case '}':
+        case ']':
+            if (--depth == 0) *done = true;
+            break;
         }
+        if (*done) break;
+    }
 
-        if (jimp->token == closeToken) {
-            depth--;
-        }
+    skip->skip_depth = depth;
+    skip->skip_in_string = in_string;
+    skip->skip_escaped = escaped;
+    return p;
+}
 
-        if (depth == 0) {
-            return true;
+static bool jimp__skip_raw(Jimp *jimp, int depth, bool in_string)
+{
+    Jimp_Push *skip = &jimp->push;
+    skip->skip_depth = depth;
+    skip->skip_in_string = in_string;
+    skip->skip_escaped = false;
+
+    while (true) {
+        if (jimp->cursor == jimp->end && jimp__refill(jimp) == -1) {
+            jimp->token = JIMP_INVALID;
+            jimp_diagf("ERROR: unexpected end of input while skipping\n");
+            return false;
         }
+
+        bool done;
+#if JIMP_STATS
+        const char *from = jimp->cursor;
+#endif
+        jimp->cursor = jimp__skip_chunk(skip, jimp->cursor, jimp->end, &done);
+        JIMP__STATS(jimp->stats.bytes_skipped += jimp->cursor - from);
+        if (done) return true;
     }
+}
 
-    return false;
+// Skips the rest of a container whose opening bracket was already consumed.
+static bool jimp__skip_open_container(Jimp *jimp, Jimp_Token closeToken) {
+    if (!jimp__skip_raw(jimp, 1, false)) return false;
+
+    char close = jimp->cursor[-1];
+    if (jimp__punct(close) != closeToken) {
+        jimp->token = JIMP_INVALID;
+        jimp_diagf("ERROR: expected %s, but got %c\n", jimp__token_kind(closeToken), close);
+        return false;
+    }
+
+    jimp->token = closeToken;
+    return true;
 }
 
 bool jimp_skip_array(Jimp *jimp) {
     if (!jimp__get_and_expect_token(jimp, JIMP_OBRACKET)) return false;
-    return jimp__skip_open_container(jimp, JIMP_OBRACKET, JIMP_CBRACKET);
+    return jimp__skip_open_container(jimp, JIMP_CBRACKET);
 }
 
 bool jimp_skip_object(Jimp *jimp) {
     if (!jimp__get_and_expect_token(jimp, JIMP_OCURLY)) return false;
-    return jimp__skip_open_container(jimp, JIMP_OCURLY, JIMP_CCURLY);
+    return jimp__skip_open_container(jimp, JIMP_CCURLY);
+}
+
+bool jimp_skip_enclosing(Jimp *jimp, int count) {
+    return jimp__skip_raw(jimp, count, false);
 }
 
 bool jimp_skip_any(Jimp *jimp) {
+    // Strings are skipped without copying them into jimp->string.
+    if (jimp_is_string_ahead(jimp)) {
+        jimp__get(jimp);
+        if (!jimp__skip_raw(jimp, 0, true)) return false;
+        jimp->token = JIMP_STRING;
+        return true;
+    }
+
     if (!jimp__get_token(jimp)) return false;
 
     switch (jimp->token) {
@@ -573,10 +1596,10 @@ bool jimp_skip_any(Jimp *jimp) {
         return false;
     }
     case JIMP_OCURLY: {
-        return jimp__skip_open_container(jimp, JIMP_OCURLY, JIMP_CCURLY);
+        return jimp__skip_open_container(jimp, JIMP_CCURLY);
     }
     case JIMP_OBRACKET: {
-        return jimp__skip_open_container(jimp, JIMP_OBRACKET, JIMP_CBRACKET);
+        return jimp__skip_open_container(jimp, JIMP_CBRACKET);
     }
     default: {
         return true;
@@ -584,4 +1607,487 @@ bool jimp_skip_any(Jimp *jimp) {
     }
 }
 
+// Push mode
+
+// What the grammar allows at the current position.
+enum {
+    JIMP__EXPECT_VALUE,
+    JIMP__EXPECT_VALUE_OR_CLOSE,    // After `[`
+    JIMP__EXPECT_MEMBER_OR_CLOSE,   // After `{`
+    JIMP__EXPECT_MEMBER,            // After `,` in an object
+    JIMP__EXPECT_COLON,
+    JIMP__EXPECT_COMMA_OR_CLOSE,
+    JIMP__EXPECT_NOTHING,           // After the top-level value
+};
+
+// The token the push parser is in the middle of.
+enum {
+    JIMP__LEX_NONE,
+    JIMP__LEX_STRING,
+    JIMP__LEX_NUMBER,
+    JIMP__LEX_SYMBOL,
+    JIMP__LEX_SKIP,
+};
+
+void jimp_push_begin(Jimp *jimp, Jimp_Handler handler, void * user_data)
+{
+    jimp__begin(jimp, user_data);
+    memset(&jimp->push, 0, sizeof(jimp->push));
+    jimp->push.handler = handler;
+    jimp->push.status = JIMP_PUSH_MORE;
+    jimp->push.expect = JIMP__EXPECT_VALUE;
+    jimp->push.lex = JIMP__LEX_NONE;
+}
+
+static void jimp__push_fail(Jimp *jimp, const char *what)
+{
+    jimp_diagf("ERROR: %s\n", what);
+    jimp->push.status = JIMP_PUSH_ERROR;
+}
+
+// Delivers event to the handler. Returns whether the parse goes on, *skip tells
+// whether the handler wants the value skipped.
+static bool jimp__push_emit(Jimp *jimp, Jimp_Event event, bool *skip)
+{
+    *skip = false;
+    switch (jimp->push.handler(jimp, event)) {
+    case JIMP_CONTINUE:
+        return true;
+    case JIMP_SKIP:
+        *skip = true;
+        return true;
+    case JIMP_STOP:
+        jimp->push.status = JIMP_PUSH_DONE;
+        jimp->stopped = true;
+        return false;
+    case JIMP_ABORT:
+        jimp->push.status = JIMP_PUSH_ERROR;
+        return false;
+    }
+    return false;
+}
+
+void jimp_push_skip_enclosing(Jimp *jimp, uint8_t count)
+{
+    if (count > jimp->push.depth) count = jimp->push.depth;
+    jimp->push.skip_enclosing = count;
+}
+
+static void jimp__push_start_skip(Jimp *jimp, int depth, bool in_string);
+
+// Leaves the containers the handler asked to skip with jimp_push_skip_enclosing.
+// Returns whether there were any.
+static bool jimp__push_unwind(Jimp *jimp)
+{
+    uint8_t count = jimp->push.skip_enclosing;
+    if (count == 0) return false;
+
+    jimp->push.skip_enclosing = 0;
+    jimp->push.depth -= count;
+    jimp__push_start_skip(jimp, count, false);
+    return true;
+}
+
+static void jimp__push_value_done(Jimp *jimp)
+{
+    if (jimp->push.depth == 0) {
+        jimp->push.expect = JIMP__EXPECT_NOTHING;
+        if (jimp->push.status == JIMP_PUSH_MORE) jimp->push.status = JIMP_PUSH_DONE;
+    } else {
+        jimp->push.expect = JIMP__EXPECT_COMMA_OR_CLOSE;
+    }
+}
+
+// A scalar value is complete. Deliver it unless its member was skipped.
+static void jimp__push_scalar(Jimp *jimp, Jimp_Event event)
+{
+    bool skip;
+    if (jimp->push.skip_value) {
+        jimp->push.skip_value = false;
+    } else if (!jimp__push_emit(jimp, event, &skip)) {
+        return;
+    } else if (jimp__push_unwind(jimp)) {
+        return;
+    }
+    jimp__push_value_done(jimp);
+}
+
+static void jimp__push_start_skip(Jimp *jimp, int depth, bool in_string)
+{
+    jimp->push.skip_value = false;
+    jimp->push.skip_depth = depth;
+    jimp->push.skip_in_string = in_string;
+    jimp->push.skip_escaped = false;
+    jimp->push.lex = JIMP__LEX_SKIP;
+}
+
+static void jimp__push_open(Jimp *jimp, bool object)
+{
+    if (jimp->push.skip_value) {
+        jimp__push_start_skip(jimp, 1, false);
+        return;
+    }
+
+    bool skip;
+    if (!jimp__push_emit(jimp, object ? JIMP_EVENT_OBJECT_BEGIN : JIMP_EVENT_ARRAY_BEGIN, &skip)) return;
+    if (skip) {
+        jimp__push_start_skip(jimp, 1, false);
+        return;
+    }
+
+    if (jimp->push.depth == JIMP_PUSH_MAX_DEPTH) {
+        jimp__push_fail(jimp, "nested too deep");
+        return;
+    }
+    if (object) jimp->push.objects |= (uint32_t)1 << jimp->push.depth;
+    else jimp->push.objects &= ~((uint32_t)1 << jimp->push.depth);
+    jimp->push.depth++;
+    jimp->push.expect = object ? JIMP__EXPECT_MEMBER_OR_CLOSE : JIMP__EXPECT_VALUE_OR_CLOSE;
+}
+
+static void jimp__push_close(Jimp *jimp, bool object)
+{
+    bool is_object = jimp->push.depth > 0 &&
+        (jimp->push.objects >> (jimp->push.depth - 1)) & 1;
+    if (jimp->push.depth == 0 || is_object != object) {
+        jimp__push_fail(jimp, object ? "unexpected }" : "unexpected ]");
+        return;
+    }
+
+    jimp->push.depth--;
+    bool skip;
+    if (!jimp__push_emit(jimp, object ? JIMP_EVENT_OBJECT_END : JIMP_EVENT_ARRAY_END, &skip)) return;
+    jimp__push_value_done(jimp);
+}
+
+static void jimp__push_string(Jimp *jimp)
+{
+    while (jimp->cursor < jimp->end) {
+        if (jimp->push.escaped) {
+            jimp->push.escaped = false;
+            int unescaped = jimp__unescape(*jimp->cursor++);
+            if (unescaped == -1) {
+                jimp__push_fail(jimp, "invalid escape sequence");
+                return;
+            }
+            jimp__append_to_key(jimp, (char)unescaped);
+            continue;
+        }
+
+        const char *run = jimp__scan(jimp->cursor, jimp->end, JIMP__SCAN_STRING);
+        if (run != jimp->cursor) {
+            jimp__append_run_to_key(jimp, jimp->cursor, run - jimp->cursor);
+            jimp->cursor = run;
+        }
+        if (jimp->cursor == jimp->end) return;
+
+        if (*jimp->cursor++ == '\\') {
+            jimp->push.escaped = true;
+            continue;
+        }
+
+        // Closing quote
+        jimp->push.lex = JIMP__LEX_NONE;
+        if (!jimp__end_string(jimp)) {
+            jimp->push.status = JIMP_PUSH_ERROR;
+            return;
+        }
+        if (jimp->push.key) {
+            bool skip;
+            if (!jimp__push_emit(jimp, JIMP_EVENT_MEMBER, &skip)) return;
+            if (jimp__push_unwind(jimp)) return;
+            jimp->push.skip_value = skip;
+            jimp->push.expect = JIMP__EXPECT_COLON;
+        } else {
+            jimp__push_scalar(jimp, JIMP_EVENT_STRING);
+        }
+        return;
+    }
+}
+
+static void jimp__push_end_number(Jimp *jimp)
+{
+    jimp->push.lex = JIMP__LEX_NONE;
+    if (!jimp__end_number(jimp)) {
+        jimp->push.status = JIMP_PUSH_ERROR;
+        return;
+    }
+    jimp__push_scalar(jimp, JIMP_EVENT_NUMBER);
+}
+
+static void jimp__push_number(Jimp *jimp)
+{
+    while (jimp->cursor < jimp->end) {
+        if (!jimp__number_char(jimp, *jimp->cursor)) {
+            jimp__push_end_number(jimp);
+            return;
+        }
+        jimp->cursor++;
+    }
+}
+
+static void jimp__push_symbol(Jimp *jimp)
+{
+    const char *symbol = jimp__symbols[jimp->push.symbol].symbol;
+    while (jimp->cursor < jimp->end && symbol[jimp->push.symbol_matched]) {
+        if (*jimp->cursor++ != symbol[jimp->push.symbol_matched++]) {
+            jimp__push_fail(jimp, "invalid symbol");
+            return;
+        }
+    }
+    if (symbol[jimp->push.symbol_matched]) return;
+
+    jimp->push.lex = JIMP__LEX_NONE;
+    switch (jimp__symbols[jimp->push.symbol].token) {
+    case JIMP_TRUE:
+        jimp->boolean = true;
+        jimp__push_scalar(jimp, JIMP_EVENT_BOOL);
+        break;
+    case JIMP_FALSE:
+        jimp->boolean = false;
+        jimp__push_scalar(jimp, JIMP_EVENT_BOOL);
+        break;
+    default:
+        jimp__push_scalar(jimp, JIMP_EVENT_NULL);
+        break;
+    }
+}
+
+static void jimp__push_skip(Jimp *jimp)
+{
+    bool done;
+#if JIMP_STATS
+    const char *from = jimp->cursor;
+#endif
+    jimp->cursor = jimp__skip_chunk(&jimp->push, jimp->cursor, jimp->end, &done);
+    JIMP__STATS(jimp->stats.bytes_skipped += jimp->cursor - from);
+    if (done) {
+        jimp->push.lex = JIMP__LEX_NONE;
+        jimp__push_value_done(jimp);
+    }
+}
+
+// Start of a value
+static void jimp__push_value(Jimp *jimp, char c)
+{
+    switch (c) {
+    case '{':
+    case '[':
+        jimp->cursor++;
+        jimp__push_open(jimp, c == '{');
+        return;
+    case '"':
+        jimp->cursor++;
+        if (jimp->push.skip_value) {
+            jimp__push_start_skip(jimp, 0, true);
+            return;
+        }
+        jimp__begin_string(jimp);
+        jimp->hash = JIMP_HASH_OFFSET;
+        jimp->push.key = false;
+        jimp->push.escaped = false;
+        jimp->push.lex = JIMP__LEX_STRING;
+        return;
+    }
+
+    for (size_t i = 0; i < jimp__symbols_count; ++i) {
+        if (*jimp__symbols[i].symbol == c) {
+            jimp->push.symbol = i;
+            jimp->push.symbol_matched = 0;
+            jimp->push.lex = JIMP__LEX_SYMBOL;
+            return;
+        }
+    }
+
+    if (jimp__is_number_char(c)) {
+        jimp__begin_number(jimp);
+        jimp->push.lex = JIMP__LEX_NUMBER;
+        return;
+    }
+
+    jimp__push_fail(jimp, "expected a value");
+}
+
+// Punctuation between tokens
+static void jimp__push_punct(Jimp *jimp)
+{
+    jimp->cursor = jimp__scan(jimp->cursor, jimp->end, JIMP__SCAN_WHITESPACE);
+    if (jimp->cursor == jimp->end) return;
+
+    // Everything but EXPECT_NOTHING, which ends the parse, starts a token.
+    JIMP__STATS(jimp->stats.tokens++);
+    char c = *jimp->cursor;
+    switch (jimp->push.expect) {
+    case JIMP__EXPECT_VALUE_OR_CLOSE:
+        if (c == ']') {
+            jimp->cursor++;
+            jimp__push_close(jimp, false);
+            return;
+        }
+        jimp__push_value(jimp, c);
+        return;
+    case JIMP__EXPECT_VALUE:
+        jimp__push_value(jimp, c);
+        return;
+    case JIMP__EXPECT_MEMBER_OR_CLOSE:
+    case JIMP__EXPECT_MEMBER:
+        jimp->cursor++;
+        if (c == '}' && jimp->push.expect == JIMP__EXPECT_MEMBER_OR_CLOSE) {
+            jimp__push_close(jimp, true);
+            return;
+        }
+        if (c != '"') {
+            jimp__push_fail(jimp, "expected a member");
+            return;
+        }
+        jimp__begin_string(jimp);
+        jimp->hash = JIMP_HASH_OFFSET;
+        jimp->push.key = true;
+        jimp->push.escaped = false;
+        jimp->push.lex = JIMP__LEX_STRING;
+        return;
+    case JIMP__EXPECT_COLON:
+        jimp->cursor++;
+        if (c != ':') {
+            jimp__push_fail(jimp, "expected :");
+            return;
+        }
+        jimp->push.expect = JIMP__EXPECT_VALUE;
+        return;
+    case JIMP__EXPECT_COMMA_OR_CLOSE: {
+        jimp->cursor++;
+        bool object = (jimp->push.objects >> (jimp->push.depth - 1)) & 1;
+        if (c == ',') {
+            jimp->push.expect = object ? JIMP__EXPECT_MEMBER : JIMP__EXPECT_VALUE;
+        } else if (c == '}' || c == ']') {
+            jimp__push_close(jimp, c == '}');
+        } else {
+            jimp__push_fail(jimp, "expected , or the end of the container");
+        }
+        return;
+    }
+    case JIMP__EXPECT_NOTHING:
+        return;
+    }
+}
+
+Jimp_Push_Status jimp_push_feed(Jimp *jimp, const char *data, size_t size)
+{
+#if JIMP_STATS
+    uint32_t started = jimp__micros();
+    jimp->stats.bytes += size;
+#endif
+    jimp->cursor = data;
+    jimp->end = data + size;
+
+    while (jimp->push.status == JIMP_PUSH_MORE && jimp->cursor < jimp->end) {
+        switch (jimp->push.lex) {
+        case JIMP__LEX_NONE:   jimp__push_punct(jimp);  break;
+        case JIMP__LEX_STRING: jimp__push_string(jimp); break;
+        case JIMP__LEX_NUMBER: jimp__push_number(jimp); break;
+        case JIMP__LEX_SYMBOL: jimp__push_symbol(jimp); break;
+        case JIMP__LEX_SKIP:   jimp__push_skip(jimp);   break;
+        }
+    }
+
+    // Don't keep pointers to the caller's buffer around.
+    jimp->cursor = jimp->end = jimp->input;
+    JIMP__STATS(jimp->stats.parse_us += jimp__micros() - started);
+    return jimp->push.status;
+}
+
+#ifdef ARDUINO
+Jimp_Push_Status jimp_push_poll(Jimp *jimp, Stream &stream)
+{
+#if JIMP_STATS
+    uint32_t started = jimp__micros();
+#endif
+    int available = stream.available();
+    if (available <= 0 || jimp->push.status != JIMP_PUSH_MORE) return jimp->push.status;
+
+    size_t want = (size_t)available;
+    if (want > sizeof(jimp->input)) want = sizeof(jimp->input);
+    size_t n = stream.readBytes(jimp->input, want);
+    JIMP__STATS(jimp->stats.wait_us += jimp__micros() - started);
+    return jimp_push_feed(jimp, jimp->input, n);
+}
+#endif
+
+Jimp_Push_Status jimp_push_end(Jimp *jimp)
+{
+    // A top-level number only ends with the input.
+    if (jimp->push.status == JIMP_PUSH_MORE && jimp->push.lex == JIMP__LEX_NUMBER && jimp->push.depth == 0) {
+        jimp__push_end_number(jimp);
+    }
+    if (jimp->push.status == JIMP_PUSH_MORE) {
+        jimp__push_fail(jimp, "unexpected end of input");
+    }
+    return jimp->push.status;
+}
+
+// Path projection
+
+static Jimp_Action jimp__paths_handler(Jimp *jimp, Jimp_Event event)
+{
+    Jimp_Path_Match *match = (Jimp_Path_Match*)jimp->user_data;
+    const Jimp_Paths *paths = match->paths;
+    uint8_t depth = jimp->push.depth;
+
+    if (match->capture != -1) {
+        Jimp_Action action = match->sink(jimp, event, match->capture, match->user_data);
+        bool closed = (event == JIMP_EVENT_OBJECT_END || event == JIMP_EVENT_ARRAY_END)
+            && depth == match->capture_depth;
+        if (closed) match->capture = -1;
+        return action;
+    }
+
+    switch (event) {
+    case JIMP_EVENT_OBJECT_END:
+    case JIMP_EVENT_ARRAY_END:
+        return JIMP_CONTINUE;
+    case JIMP_EVENT_MEMBER:
+        // A name that didn't fit the arena can't be compared, so it never matches.
+        match->member = jimp->truncated ? 0
+            : jimp__paths_child(paths, match->nodes[depth - 1], false, jimp->hash, jimp->string, jimp->string_count);
+        return match->member ? JIMP_CONTINUE : JIMP_SKIP;
+    default:
+        break;
+    }
+
+    // The start of a value.
+    uint8_t node = 0;
+    if (depth > 0) {
+        bool in_object = (jimp->push.objects >> (depth - 1)) & 1;
+        node = in_object ? match->member : jimp__paths_child(paths, match->nodes[depth - 1], true, 0, nullptr, 0);
+    }
+    bool container = event == JIMP_EVENT_OBJECT_BEGIN || event == JIMP_EVENT_ARRAY_BEGIN;
+    if (depth > 0 && node == 0) {
+        // An array element nobody asked for.
+        return container ? JIMP_SKIP : JIMP_CONTINUE;
+    }
+
+    int8_t selector = paths->nodes[node].selector;
+    if (selector != -1) {
+        Jimp_Action action = match->sink(jimp, event, selector, match->user_data);
+        if (container && action == JIMP_CONTINUE) {
+            match->capture = selector;
+            match->capture_depth = depth;
+        }
+        return action;
+    }
+
+    if (container) match->nodes[depth] = node;
+    return JIMP_CONTINUE;
+}
+
+void jimp_paths_begin(Jimp *jimp, Jimp_Path_Match *match, const Jimp_Paths *paths, Jimp_Path_Sink sink, void *user_data)
+{
+    memset(match, 0, sizeof(*match));
+    match->paths = paths;
+    match->sink = sink;
+    match->user_data = user_data;
+    match->capture = -1;
+    jimp_push_begin(jimp, jimp__paths_handler, match);
+}
+
 #endif // JIMP_IMPLEMENTATION
@@ -0,0 +1,582 @@
+// Declarative schemas for jimp. A schema describes the parts of a JSON document
+// we care about and where their values go. From it the compiler generates both
+// a pull parser (jimp_schema::parse) and the tables for a push parser
+// (jimp_schema::push_begin). Members that are not declared are skipped with the
+// raw byte scanner, so they cost nothing but the scan.
+//
+//     struct Departure { int number; DateTime planned; };
+//
+//     using DepartureSchema = Object<
+//         Member<JIMP_KEY("departureTimePlanned"), Time<&Departure::planned>>,
+//         Member<JIMP_KEY("transportation"), Object<
+//             Member<JIMP_KEY("number"), Atoi<&Departure::number>>
+//         >>
+//     >;
+//
+// Objects nested in the schema write into the same target as their parent. Each
+// switches the target to a member of the parent for every array element and
+// hands the element to a callback when it is complete.
+// vim: tabstop=4 shiftwidth=4 autoindent smartindent expandtab
+
+#ifndef JIMP_SCHEMA_H_
+#define JIMP_SCHEMA_H_
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "jimp.h"
+#include "datetime.h"
+
+// Fail on members of closed objects that the schema doesn't know instead of
+// skipping them. Handy to find out what changed in a response.
+#ifndef JIMP_SCHEMA_STRICT
+#define JIMP_SCHEMA_STRICT 0
+#endif
+
+namespace jimp_schema {
+
+enum class Result : uint8_t {
+    Ok,
+    Failed,
+    // A callback had enough, see Each. jimp->stopped is set.
+    Stopped,
+    // A Filter turned down the array element it is in. The rest of the
+    // element gets skipped.
+    Rejected,
+};
+
+// What jimp->user_data points to while a schema is parsed.
+struct Context {
+    // Target of the whole document.
+    void *root;
+};
+
+// Push mode ------------------------------------------------------------------
+
+enum class Kind : uint8_t {
+    Object,
+    Array,
+    Scalar,
+};
+
+// Type erased description of a schema node for the push handler. Every node
+// type has one per target type as Node::push_node<T>.
+struct PushNode {
+    Kind kind;
+    // Object: looks up the member just read. Its node goes to *node, or
+    // nullptr if it is to be skipped.
+    Jimp_Action (*member)(Jimp *jimp, const PushNode **node);
+    // Array: the node of the elements, where they are parsed to and what
+    // happens when one is complete. element_done returns whether to go on.
+    const PushNode *element;
+    void *(*element_begin)(void *target);
+    bool (*element_done)(void *target, void *element);
+    // Scalar: consumes a STRING, NUMBER, BOOL or NULL event.
+    Result (*scalar)(Jimp *jimp, Jimp_Event event, void *target);
+    // Any kind: null is fine too and leaves the target as it is, see Nullable.
+    bool nullable;
+};
+
+// How deep the declared part of a document may go. Skipped values don't count.
+static constexpr uint8_t MAX_DEPTH{8};
+
+// Everything the push handler needs to resume between two chunks.
+struct PushParser {
+    Context context;
+    struct Frame {
+        const PushNode *node;
+        void *target;
+    };
+    Frame frames[MAX_DEPTH];
+    // Node of the member that was just read.
+    const PushNode *member;
+    const PushNode *root;
+};
+
+inline Jimp_Action push_value_done(PushParser *parser, uint8_t depth, void *target) {
+    if (depth == 0) return JIMP_CONTINUE;
+    PushParser::Frame const &parent = parser->frames[depth - 1];
+    if (parent.node->kind != Kind::Array || !parent.node->element_done) return JIMP_CONTINUE;
+    return parent.node->element_done(parent.target, target) ? JIMP_CONTINUE : JIMP_STOP;
+}
+
+// Leaves the array element the value at depth is in, or the whole document if
+// it isn't in one.
+inline Jimp_Action push_reject(Jimp *jimp, PushParser *parser, uint8_t depth) {
+    uint8_t element = 0;
+    for (uint8_t i = depth; i > 1; i--) {
+        if (parser->frames[i - 2].node->kind == Kind::Array) {
+            element = i - 1;
+            break;
+        }
+    }
+    jimp_push_skip_enclosing(jimp, depth - element);
+    return JIMP_CONTINUE;
+}
+
+inline Jimp_Action push_handler(Jimp *jimp, Jimp_Event event) {
+    PushParser * const parser = reinterpret_cast<PushParser *>(jimp->user_data);
+    uint8_t const depth = jimp->push.depth;
+
+    if (event == JIMP_EVENT_MEMBER) {
+        return parser->frames[depth - 1].node->member(jimp, &parser->member);
+    }
+
+    if (event == JIMP_EVENT_OBJECT_END || event == JIMP_EVENT_ARRAY_END) {
+        return push_value_done(parser, depth, parser->frames[depth].target);
+    }
+
+    // The start of a value: find out what it is to us.
+    const PushNode *node = parser->root;
+    void *target = parser->context.root;
+    if (depth > 0) {
+        PushParser::Frame const &parent = parser->frames[depth - 1];
+        if (parent.node->kind == Kind::Array) {
+            node = parent.node->element;
+            target = parent.node->element_begin(parent.target);
+        } else {
+            node = parser->member;
+            target = parent.target;
+        }
+    }
+
+    if (event == JIMP_EVENT_NULL && node->nullable) {
+        return push_value_done(parser, depth, target);
+    }
+
+    switch (event) {
+    case JIMP_EVENT_OBJECT_BEGIN:
+    case JIMP_EVENT_ARRAY_BEGIN: {
+        Kind const kind = event == JIMP_EVENT_OBJECT_BEGIN ? Kind::Object : Kind::Array;
+        if (node->kind != kind) {
+            jimp_diagf("ERROR: unexpected %s\n", kind == Kind::Object ? "object" : "array");
+            return JIMP_ABORT;
+        }
+        if (depth >= MAX_DEPTH) {
+            jimp_diagf("ERROR: schema nested too deep\n");
+            return JIMP_ABORT;
+        }
+        parser->frames[depth] = PushParser::Frame{node, target};
+        return JIMP_CONTINUE;
+    }
+    default:
+        if (node->kind != Kind::Scalar) {
+            jimp_diagf("ERROR: expected %s\n", node->kind == Kind::Object ? "object" : "array");
+            return JIMP_ABORT;
+        }
+        switch (node->scalar(jimp, event, target)) {
+        case Result::Ok:
+            return push_value_done(parser, depth, target);
+        case Result::Rejected:
+            return push_reject(jimp, parser, depth);
+        case Result::Stopped:
+            return JIMP_STOP;
+        default:
+            return JIMP_ABORT;
+        }
+    }
+}
+
+/// Starts a push mode parse of Schema into target.
+template <typename Schema, typename T>
+void push_begin(Jimp *jimp, PushParser *parser, T *target) {
+    *parser = PushParser{};
+    parser->context.root = target;
+    parser->root = &Schema::template push_node<T>;
+    jimp_push_begin(jimp, push_handler, parser);
+}
+
+// Pull mode ------------------------------------------------------------------
+
+/// Parses a document described by Schema into target. Also succeeds if a
+/// callback had enough before the end, see Jimp::stopped.
+template <typename Schema, typename T>
+bool parse(Jimp *jimp, T &target) {
+    Context context{&target};
+    void * const user_data = jimp->user_data;
+    jimp->user_data = &context;
+    Result const result = Schema::parse(jimp, target);
+    jimp->user_data = user_data;
+    return result != Result::Failed;
+}
+
+// Nodes ----------------------------------------------------------------------
+
+/// The name of a member, as a type. Write JIMP_KEY("name") to get one. Members
+/// are looked up by jimp_hash, and on a hit the name itself is compared, so an
+/// unknown member that happens to hash the same is still unknown. The name is
+/// compared in code, it takes no RAM.
+template <char... Chars>
+struct Key {
+    static constexpr size_t length = sizeof...(Chars);
+
+    static constexpr uint32_t hash_of() {
+        uint32_t hash = JIMP_HASH_OFFSET;
+        ((hash = jimp__hash_step(hash, Chars)), ...);
+        return hash;
+    }
+    static constexpr uint32_t hash = hash_of();
+
+    template <size_t... I>
+    static bool equals(const char *s, std::index_sequence<I...>) { return ((s[I] == Chars) && ...); }
+
+    // Whether the member just read into jimp->string is this one.
+    static bool matches(Jimp *jimp) {
+        return jimp->hash == hash && !jimp->truncated && jimp->string_count == length
+            && equals(jimp->string, std::make_index_sequence<length>{});
+    }
+};
+
+// Longest name JIMP_KEY takes.
+static constexpr size_t MAX_KEY_LENGTH{32};
+
+template <size_t N>
+constexpr char key_char(const char (&s)[N], size_t i) { return i < N ? s[i] : '\0'; }
+
+// Key of the first Length of Chars, which JIMP_KEY pads with zeros.
+template <size_t Length, typename Indices, char... Chars>
+struct MakeKey;
+template <size_t Length, size_t... I, char... Chars>
+struct MakeKey<Length, std::index_sequence<I...>, Chars...> {
+    static_assert(Length <= MAX_KEY_LENGTH, "Name too long for JIMP_KEY");
+    static constexpr char chars[] = {Chars...};
+    using type = Key<chars[I]...>;
+};
+
+template <size_t Length, char... Chars>
+using KeyOf = typename MakeKey<Length, std::make_index_sequence<Length>, Chars...>::type;
+
+#define JIMP__KEY_CHARS8(s, i) \
+    jimp_schema::key_char(s, i), jimp_schema::key_char(s, i + 1), \
+    jimp_schema::key_char(s, i + 2), jimp_schema::key_char(s, i + 3), \
+    jimp_schema::key_char(s, i + 4), jimp_schema::key_char(s, i + 5), \
+    jimp_schema::key_char(s, i + 6), jimp_schema::key_char(s, i + 7)
+#define JIMP_KEY(s) jimp_schema::KeyOf<sizeof(s) - 1, \
+    JIMP__KEY_CHARS8(s, 0), JIMP__KEY_CHARS8(s, 8), \
+    JIMP__KEY_CHARS8(s, 16), JIMP__KEY_CHARS8(s, 24)>
+
+// A member name an object knows, and which of its entries it belongs to.
+struct KeySlot {
+    uint32_t hash;
+    bool (*matches)(Jimp *jimp);
+    uint8_t entry;
+};
+
+/// Member Name (a JIMP_KEY) of an object, described by Value.
+template <typename Name, typename Value>
+struct Member {
+    static constexpr bool declared = true;
+    static constexpr size_t key_count = 1;
+    static constexpr void collect_keys(KeySlot *keys, size_t &count, uint8_t entry) {
+        keys[count++] = KeySlot{Name::hash, Name::matches, entry};
+    }
+
+    template <typename T>
+    static Result parse(Jimp *jimp, T &target) { return Value::parse(jimp, target); }
+
+    template <typename T>
+    static const PushNode *push_node() { return &Value::template push_node<T>; }
+};
+
+/// Members of an object that we know about but don't need. They get skipped
+/// silently. An object with a Known entry is closed: members that are neither
+/// declared nor known are unexpected, see Object.
+template <typename... Names>
+struct Known {
+    static constexpr bool declared = false;
+    static constexpr size_t key_count = sizeof...(Names);
+    static constexpr void collect_keys(KeySlot *keys, size_t &count, uint8_t entry) {
+        ((keys[count++] = KeySlot{Names::hash, Names::matches, entry}), ...);
+    }
+};
+
+template <typename Entry>
+struct IsKnown : std::false_type {};
+template <typename... Names>
+struct IsKnown<Known<Names...>> : std::true_type {};
+
+/// An object. Members that are not listed are skipped. If the object is closed
+/// (see Known) an unexpected member is counted with jimp_unexpected_member, or
+/// fails the parse if JIMP_SCHEMA_STRICT is set.
+///
+/// The names of all entries are sorted by jimp_hash at compile time. A member
+/// is looked up with a binary search over them, which the compiler unrolls into
+/// compares against constants, so the table takes no RAM. On a hit the name
+/// itself is compared once.
+template <typename... Entries>
+struct Object {
+    static constexpr bool closed = (IsKnown<Entries>::value || ...);
+
+    static constexpr size_t key_count = (Entries::key_count + ... + 0);
+    static_assert(sizeof...(Entries) < UINT8_MAX, "Too many entries");
+
+    struct KeyTable {
+        KeySlot keys[key_count + 1];
+        bool distinct;
+    };
+
+    template <size_t... I>
+    static constexpr KeyTable sorted_keys(std::index_sequence<I...>) {
+        KeyTable table = {};
+        size_t count = 0;
+        (Entries::collect_keys(table.keys, count, (uint8_t)I), ...);
+        for (size_t i = 1; i < count; i++) {
+            for (size_t j = i; j > 0 && table.keys[j].hash < table.keys[j - 1].hash; j--) {
+                KeySlot const key = table.keys[j];
+                table.keys[j] = table.keys[j - 1];
+                table.keys[j - 1] = key;
+            }
+        }
+        table.distinct = true;
+        for (size_t i = 1; i < count; i++) {
+            if (table.keys[i].hash == table.keys[i - 1].hash) table.distinct = false;
+        }
+        return table;
+    }
+    static constexpr KeyTable keys = sorted_keys(std::index_sequence_for<Entries...>{});
+    static_assert(keys.distinct, "Duplicate member or jimp_hash collision");
+
+    template <size_t I>
+    using EntryAt = typename std::tuple_element<I, std::tuple<Entries...>>::type;
+
+    // Calls found with the index of the entry the member just read belongs to,
+    // as a std::integral_constant, or missing if there is none.
+    template <size_t Low = 0, size_t High = key_count, typename Found, typename Missing>
+    static auto find(Jimp *jimp, Found &&found, Missing &&missing) {
+        if constexpr (Low == High) {
+            return missing();
+        } else {
+            constexpr size_t middle = (Low + High) / 2;
+            constexpr uint32_t hash = keys.keys[middle].hash;
+            if (jimp->hash < hash) return find<Low, middle>(jimp, found, missing);
+            if (jimp->hash > hash) return find<middle + 1, High>(jimp, found, missing);
+            constexpr bool (*matches)(Jimp *) = keys.keys[middle].matches;
+            if (!matches(jimp)) return missing();
+            return found(std::integral_constant<size_t, keys.keys[middle].entry>{});
+        }
+    }
+
+    // Whether the member just read, which no entry knows, may be skipped.
+    static bool skippable(Jimp *jimp) {
+        if (!closed) return true;
+#if JIMP_SCHEMA_STRICT
+        jimp_unknown_member(jimp);
+        return false;
+#else
+        jimp_unexpected_member(jimp);
+        return true;
+#endif
+    }
+
+    template <typename T>
+    static Result parse(Jimp *jimp, T &target) {
+        if (!jimp_object_begin(jimp)) return Result::Failed;
+
+        while (jimp_object_member(jimp)) {
+            Result const result = find(jimp,
+                [&](auto entry) {
+                    using Entry = EntryAt<decltype(entry)::value>;
+                    if constexpr (Entry::declared) {
+                        return Entry::parse(jimp, target);
+                    } else {
+                        return jimp_skip_any(jimp) ? Result::Ok : Result::Failed;
+                    }
+                },
+                [&] { return skippable(jimp) && jimp_skip_any(jimp) ? Result::Ok : Result::Failed; });
+            if (result == Result::Rejected) {
+                return jimp_skip_enclosing(jimp, 1) ? Result::Rejected : Result::Failed;
+            }
+            if (result != Result::Ok) return result;
+        }
+
+        return jimp_object_end(jimp) ? Result::Ok : Result::Failed;
+    }
+
+    template <typename T>
+    static Jimp_Action push_member(Jimp *jimp, const PushNode **node) {
+        *node = nullptr;
+        return find(jimp,
+            [&](auto entry) {
+                using Entry = EntryAt<decltype(entry)::value>;
+                if constexpr (Entry::declared) {
+                    *node = Entry::template push_node<T>();
+                    return JIMP_CONTINUE;
+                } else {
+                    return JIMP_SKIP;
+                }
+            },
+            [&] { return skippable(jimp) ? JIMP_SKIP : JIMP_ABORT; });
+    }
+
+    template <typename T>
+    static constexpr PushNode push_node{Kind::Object, push_member<T>, nullptr, nullptr, nullptr, nullptr, false};
+};
+
+/// An array whose elements are parsed as Element into target.*Field, which is
+/// reset for every element. Done(target, element) gets called after every
+/// element and returns whether to go on. If it doesn't, the parse ends right
+/// there: jimp_schema::parse succeeds with jimp->stopped set, push mode ends
+/// with JIMP_PUSH_DONE. Elements turned down by a Filter are dropped without
+/// calling Done.
+template <auto Field, typename Element, auto Done>
+struct Each {
+    template <typename T>
+    using ElementOf = typename std::remove_reference<decltype(std::declval<T &>().*Field)>::type;
+
+    template <typename T>
+    static Result parse(Jimp *jimp, T &target) {
+        if (!jimp_array_begin(jimp)) return Result::Failed;
+
+        while (jimp_array_item(jimp)) {
+            ElementOf<T> &element = target.*Field;
+            element = ElementOf<T>{};
+            Result const result = Element::parse(jimp, element);
+            if (result == Result::Rejected) continue;
+            if (result != Result::Ok) return result;
+            if (!Done(target, element)) {
+                jimp->stopped = true;
+                return Result::Stopped;
+            }
+        }
+
+        return jimp_array_end(jimp) ? Result::Ok : Result::Failed;
+    }
+
+    template <typename T>
+    static void *push_element_begin(void *target) {
+        ElementOf<T> &element = static_cast<T *>(target)->*Field;
+        element = ElementOf<T>{};
+        return &element;
+    }
+
+    template <typename T>
+    static bool push_element_done(void *target, void *element) {
+        return Done(*static_cast<T *>(target), *static_cast<ElementOf<T> *>(element));
+    }
+
+    template <typename T>
+    static constexpr PushNode push_node{Kind::Array, nullptr,
+        &Element::template push_node<ElementOf<T>>,
+        push_element_begin<T>, push_element_done<T>, nullptr, false};
+};
+
+/// A scalar Value that decides whether the array element it is in is worth
+/// parsing. Once Value is stored, Accept(root, target) gets called with the
+/// target of the whole document. If it returns false, the rest of the element
+/// is skipped with the raw scanner and the element is dropped, see Each.
+template <typename Value, auto Accept>
+struct Filter {
+    template <typename Root, typename T>
+    static Root *root_of(bool (*)(Root const &, T const &));
+
+    template <typename T>
+    static bool accept(Jimp *jimp, T const &target) {
+        using Root = typename std::remove_pointer<decltype(root_of(Accept))>::type;
+        Context const *context = reinterpret_cast<Context const *>(jimp->user_data);
+        return Accept(*static_cast<Root const *>(context->root), target);
+    }
+
+    template <typename T>
+    static Result parse(Jimp *jimp, T &target) {
+        Result const result = Value::parse(jimp, target);
+        if (result != Result::Ok) return result;
+        return accept(jimp, target) ? Result::Ok : Result::Rejected;
+    }
+
+    template <typename T>
+    static Result push_scalar(Jimp *jimp, Jimp_Event event, void *target) {
+        Result const result = Value::template push_node<T>.scalar(jimp, event, target);
+        if (result != Result::Ok) return result;
+        return accept(jimp, *static_cast<T const *>(target)) ? Result::Ok : Result::Rejected;
+    }
+
+    template <typename T>
+    static constexpr PushNode push_node{Kind::Scalar, nullptr, nullptr, nullptr, nullptr, push_scalar<T>, false};
+};
+
+/// Value or null. Optional members are sometimes there but null instead of
+/// left out. null leaves the target as it is, like a missing member.
+template <typename Value>
+struct Nullable {
+    template <typename T>
+    static Result parse(Jimp *jimp, T &target) {
+        if (jimp_is_null_ahead(jimp)) return jimp_skip_any(jimp) ? Result::Ok : Result::Failed;
+        return Value::parse(jimp, target);
+    }
+
+    static constexpr PushNode nullable(PushNode node) {
+        node.nullable = true;
+        return node;
+    }
+
+    template <typename T>
+    static constexpr PushNode push_node = nullable(Value::template push_node<T>);
+};
+
+/// Base of the nodes for string values. Derived::set(jimp, target) gets the
+/// string in jimp->string and returns whether it was acceptable.
+template <typename Derived>
+struct StringValue {
+    template <typename T>
+    static Result parse(Jimp *jimp, T &target) {
+        if (!jimp_string(jimp) || !Derived::set(jimp, target)) return Result::Failed;
+        return Result::Ok;
+    }
+
+    template <typename T>
+    static Result push_scalar(Jimp *jimp, Jimp_Event event, void *target) {
+        if (event != JIMP_EVENT_STRING) {
+            jimp_diagf("ERROR: expected string\n");
+            return Result::Failed;
+        }
+        return Derived::set(jimp, *static_cast<T *>(target)) ? Result::Ok : Result::Failed;
+    }
+
+    template <typename T>
+    static constexpr PushNode push_node{Kind::Scalar, nullptr, nullptr, nullptr, nullptr, push_scalar<T>, false};
+};
+
+/// The first character of a string.
+template <auto Field>
+struct FirstChar : StringValue<FirstChar<Field>> {
+    template <typename T>
+    static bool set(Jimp *jimp, T &target) {
+        target.*Field = *jimp->string;
+        return true;
+    }
+};
+
+/// A string holding an integer, like the line numbers.
+template <auto Field>
+struct Atoi : StringValue<Atoi<Field>> {
+    template <typename T>
+    static bool set(Jimp *jimp, T &target) {
+        target.*Field = atoi(jimp->string);
+        return true;
+    }
+};
+
+/// An ISO 8601 timestamp. If given, Flag is set when the member is present.
+template <auto Field, auto Flag = nullptr>
+struct Time : StringValue<Time<Field, Flag>> {
+    template <typename T>
+    static bool set(Jimp *jimp, T &target) {
+        target.*Field = DateTime(jimp->string);
+        if constexpr (Flag != nullptr) target.*Flag = true;
+        return true;
+    }
+};
+
+/// A string handed to Set(jimp, target), which returns whether it was acceptable.
+template <auto Set>
+struct Call : StringValue<Call<Set>> {
+    template <typename T>
+    static bool set(Jimp *jimp, T &target) {
+        return Set(jimp, target);
+    }
+};
+
+} // namespace jimp_schema
+
+#endif // JIMP_SCHEMA_H_
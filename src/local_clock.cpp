@@ -0,0 +1,132 @@
+#include "local_clock.h"
+
+#include "datetime.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Assumed until measured. Crystals are within 100 ppm, usually much less.
+static constexpr uint32_t DRIFT_UNKNOWN_PPB{100'000};
+// Measuring drift over less than this mostly measures the sync uncertainty.
+static constexpr uint32_t MIN_DRIFT_SPAN_MS{10 * 60 * 1000};
+// Crystals change speed with temperature, so don't average over more than this.
+static constexpr uint32_t MAX_DRIFT_SPAN_MS{24 * 60 * 60 * 1000};
+// A sync this much further off than expected is a jump, not drift.
+static constexpr uint32_t STEP_MS{1000};
+
+void LocalClock::sync(uint32_t localMillis, uint64_t unixMillis, uint32_t uncertainty) {
+	Sample const sample{localMillis, unixMillis, uncertainty};
+	if (synced()) {
+		int64_t const error = (int64_t)(unixMillis - this->unixMillis(localMillis));
+		uint64_t const allowed = (uint64_t)this->uncertainty(localMillis) + uncertainty + STEP_MS;
+		if ((uint64_t)(error < 0 ? -error : error) <= allowed) {
+			if (uncertainty >= this->uncertainty(localMillis)) {
+				return;
+			}
+			last = sample;
+			if (last.localMillis - base.localMillis > MAX_DRIFT_SPAN_MS) {
+				base = middle;
+			}
+			if (middle.localMillis - base.localMillis < MAX_DRIFT_SPAN_MS / 2) {
+				middle = last;
+			}
+			estimateDrift();
+			syncs++;
+			return;
+		}
+	}
+
+	// First sync, or the reference or millis() jumped. Start over from here.
+	base = middle = last = sample;
+	driftPpb = 0;
+	driftUncertaintyPpb = DRIFT_UNKNOWN_PPB;
+	syncs++;
+}
+
+void LocalClock::estimateDrift() {
+	uint32_t const span = last.localMillis - base.localMillis;
+	if (span < MIN_DRIFT_SPAN_MS) {
+		return;
+	}
+	int64_t const gained = (int64_t)(last.unixMillis - base.unixMillis) - span;
+	uint64_t const uncertainty = ((uint64_t)base.uncertainty + last.uncertainty) * 1'000'000'000 / span;
+	// Over a short span after base moved up, the old estimate may be better.
+	if (uncertainty >= DRIFT_UNKNOWN_PPB && driftUncertaintyPpb < DRIFT_UNKNOWN_PPB) {
+		return;
+	}
+	driftPpb = gained * 1'000'000'000 / span;
+	driftUncertaintyPpb = uncertainty < DRIFT_UNKNOWN_PPB ? uncertainty : DRIFT_UNKNOWN_PPB;
+}
+
+uint64_t LocalClock::unixMillis(uint32_t localMillis) const {
+	uint32_t const elapsed = localMillis - last.localMillis;
+	return last.unixMillis + elapsed + (int64_t)elapsed * driftPpb / 1'000'000'000;
+}
+
+uint32_t LocalClock::uncertainty(uint32_t localMillis) const {
+	if (!synced()) {
+		return UINT32_MAX;
+	}
+	uint32_t const elapsed = localMillis - last.localMillis;
+	uint64_t const uncertainty = last.uncertainty + (uint64_t)elapsed * driftUncertaintyPpb / 1'000'000'000;
+	return uncertainty < UINT32_MAX ? uncertainty : UINT32_MAX;
+}
+
+// Seconds from 1900, where NTP starts, to 1970
+static constexpr uint64_t NTP_UNIX_OFFSET{2'208'988'800};
+
+void ntp_request(uint8_t packet[NTP_PACKET_SIZE]) {
+	memset(packet, 0, NTP_PACKET_SIZE);
+	// No leap second warning, version 4, client
+	packet[0] = 0b00'100'011;
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+bool ntp_response(const uint8_t packet[NTP_PACKET_SIZE], uint64_t *unixMillis) {
+	uint8_t const leap = packet[0] >> 6;
+	uint8_t const mode = packet[0] & 0b111;
+	uint8_t const stratum = packet[1];
+	// Leap indicator 3 means the server's clock isn't synchronized, stratum 0
+	// is a kiss-o'-death telling us to go away.
+	if (mode != 4 || leap == 3 || stratum == 0) {
+		return false;
+	}
+	uint64_t seconds = read_u32(packet + 40);
+	uint32_t const fraction = read_u32(packet + 44);
+	if (seconds == 0) {
+		return false;
+	}
+	// The seconds wrap in 2036. Before that the top bit is set (RFC 4330,
+	// section 3).
+	if ((seconds & 0x8000'0000) == 0) {
+		seconds += (uint64_t)1 << 32;
+	}
+	*unixMillis = (seconds - NTP_UNIX_OFFSET) * 1000 + (((uint64_t)fraction * 1000) >> 32);
+	return true;
+}
+
+bool http_date(const char *date, uint32_t *unixTime) {
+	static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+	char weekday[4], monthName[4], zone[4];
+	unsigned day, year, hour, minute, second;
+	int end = 0;
+	if (sscanf(date, "%3s, %2u %3s %4u %2u:%2u:%2u %3s%n",
+			weekday, &day, monthName, &year, &hour, &minute, &second, zone, &end) != 8
+			|| date[end] != '\0' || strcmp(zone, "GMT") != 0) {
+		return false;
+	}
+	const char *month = strstr(months, monthName);
+	if (strlen(monthName) != 3 || !month || (month - months) % 3 != 0) {
+		return false;
+	}
+	// Also rejects anything out of range
+	DateTime const time(year, (month - months) / 3 + 1, day, hour, minute, second);
+	if (year < 1970 || !time.isValid()) {
+		return false;
+	}
+	*unixTime = time.unixtime();
+	return true;
+}
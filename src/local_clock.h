@@ -0,0 +1,73 @@
+#ifndef LOCAL_CLOCK
+#define LOCAL_CLOCK
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Time since the Unix epoch, read from millis() and set now and then from a
+// reference like the Date of an HTTP response or NTP. Between syncs, it
+// corrects for how fast the crystal behind millis() runs, which it learns from
+// how far apart the syncs are by either clock. Every reading comes with how far
+// off it may be.
+//
+// All times are in ms. localMillis is millis() at the moment in question.
+class LocalClock {
+public:
+	// The reference read unixMillis at localMillis, give or take uncertainty.
+	// For NTP, that is half the round trip. Readings that agree with the clock
+	// but are less certain than it already is are ignored.
+	void sync(uint32_t localMillis, uint64_t unixMillis, uint32_t uncertainty);
+
+	bool synced() const { return syncs > 0; }
+	// Only meaningful if synced().
+	uint64_t unixMillis(uint32_t localMillis) const;
+	uint32_t unixTime(uint32_t localMillis) const { return unixMillis(localMillis) / 1000; }
+	// How far unixMillis() may be off, UINT32_MAX if not synced.
+	uint32_t uncertainty(uint32_t localMillis) const;
+
+	// How much faster the reference runs than millis(), in parts per billion.
+	int32_t drift() const { return driftPpb; }
+	// How far drift() may be off.
+	uint32_t driftUncertainty() const { return driftUncertaintyPpb; }
+
+private:
+	// A point in time by both clocks.
+	struct Sample {
+		uint32_t localMillis;
+		uint64_t unixMillis;
+		uint32_t uncertainty;
+	};
+
+	// Estimates the drift from the time between base and last.
+	void estimateDrift();
+
+	// The latest sync, which readings count from.
+	Sample last = {};
+	// An earlier sync that the drift is measured against. The further back,
+	// the less the uncertainty of both matters.
+	Sample base = {};
+	// The first sync at least half the longest span after base, which becomes
+	// base when base gets too old for the drift to still be the same.
+	Sample middle = {};
+
+	int32_t driftPpb = 0;
+	uint32_t driftUncertaintyPpb = 0;
+	uint32_t syncs = 0;
+};
+
+// An SNTP (RFC 4330) request and response are this long.
+static constexpr size_t NTP_PACKET_SIZE{48};
+
+// Fills packet with a client request.
+void ntp_request(uint8_t packet[NTP_PACKET_SIZE]);
+// Reads the server's transmit time from a response into unixMillis. Returns
+// false for anything that is not a usable time, like a kiss-o'-death packet
+// or a server that isn't synchronized itself.
+bool ntp_response(const uint8_t packet[NTP_PACKET_SIZE], uint64_t *unixMillis);
+
+// Reads the Date header of an HTTP response, like "Sun, 06 Nov 1994 08:49:37
+// GMT", into unixTime. Only the fixed format servers are required to send
+// (RFC 9110, section 5.6.7) is understood.
+bool http_date(const char *date, uint32_t *unixTime);
+
+#endif // LOCAL_CLOCK
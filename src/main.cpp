@@ -13,9 +13,11 @@
 #include <WiFiClientSecureBearSSL.h>
 #define WiFiClientSecureType BearSSL::WiFiClientSecure
 #endif
-#include <NTPClient.h>
 #include <WiFiUdp.h>
 
+#include <memory>
+#include <new>
+
 #include <Fonts/FreeMonoBold18pt7b.h>
 #include <Fonts/FreeMonoBold12pt7b.h>
 #include <GxEPD2_BW.h>
@@ -24,6 +26,11 @@
 #include "certs.h"
 #include "secrets.h"
 
+#include "body_parser.h"
+#include "efa_request.h"
+#include "http_body.h"
+#include "inflate.h"
+#include "local_clock.h"
 #include "stop_parser.h"
 #define JIMP_IMPLEMENTATION
 #include "jimp.h"
@@ -32,9 +39,21 @@
 SPIClass hspi(HSPI);
 #endif
 
+// Set to 1 in secrets.h if the server is known to agree to a maximum fragment
+// length, see setupTls(). The smaller TLS buffers make room for a bigger
+// display buffer, and fewer pages make a faster refresh. Whether the server
+// agrees is only found out at runtime, so this is the promise that it does.
+#ifndef TLS_SERVER_HAS_MFLN
+#define TLS_SERVER_HAS_MFLN 0
+#endif
+
 #if defined (ESP8266)
 // #define MAX_DISPLAY_BUFFER_SIZE (81920ul-34000ul-5000ul) // ~34000 base use, change 5000 to your application use
+#if TLS_SERVER_HAS_MFLN
+#define MAX_DISPLAY_BUFFER_SIZE (16000ul)
+#else
 #define MAX_DISPLAY_BUFFER_SIZE (8000ul)
+#endif
 #define MAX_HEIGHT(EPD) (EPD::HEIGHT <= MAX_DISPLAY_BUFFER_SIZE / (EPD::WIDTH / 8) ? EPD::HEIGHT : MAX_DISPLAY_BUFFER_SIZE / (EPD::WIDTH / 8))
 #define PIN_CS SS  // Use the default CS pin (NodeMCU: GPIO15=D8).
 #define PIN_DC 0   // NodeMCU: GPIO0=D3
@@ -53,8 +72,17 @@ GxEPD2_DISPLAY_CLASS<GxEPD2_DRIVER_CLASS, GxEPD2_DRIVER_CLASS::HEIGHT> display(G
 #endif
 
 WiFiClientSecureType client;
+#ifndef ESP32
+// Lets BearSSL resume the last TLS session when the connection has to be
+// opened again, which saves most of the handshake.
+BearSSL::Session tlsSession;
+#endif
 static constexpr size_t NUM_STOPS{9};
 static constexpr size_t BUF_LEN{30};
+// Give up on a response if no data arrived for this long.
+static constexpr uint32_t STALL_TIMEOUT_MS{5'000};
+// How long to wait for the end of a response after the parse is done.
+static constexpr uint32_t BODY_END_TIMEOUT_MS{200};
 
 struct FormattedPlatform {
 	char buffer[NUM_STOPS][BUF_LEN];
@@ -65,14 +93,81 @@ struct FormattedStops {
 	FormattedPlatform platform_a;
 	FormattedPlatform platform_e;
 } formattedStops{};
+// One column each, see showPlatform().
+static constexpr size_t NUM_PLATFORMS{sizeof(FormattedStops) / sizeof(FormattedPlatform)};
+
+// Size of the backing store for jimp.string. We only ever look at short values
+// (platform, line number, timestamps), so longer strings are truncated rather
+// than grown on the heap.
+static constexpr size_t JIMP_ARENA_SIZE{256};
+
+// Ask for a compressed response. It is a fraction of the size, which matters
+// more on a weak Wi-Fi link than the time spent inflating it. The decoder needs
+// the 32 KiB window the server compresses with, which the ESP8266 doesn't have
+// to spare next to BearSSL.
+#ifndef ACCEPT_GZIP
+#ifdef ESP32
+#define ACCEPT_GZIP 1
+#else
+#define ACCEPT_GZIP 0
+#endif
+#endif
+static constexpr size_t INFLATE_WINDOW_SIZE{32 * 1024};
 
-Jimp jimp = {0};
+// Too big for the stack, so it only gets allocated for compressed responses.
+struct Inflater {
+	Inflate inflate;
+	char window[INFLATE_WINDOW_SIZE];
+};
 
 HTTPClient http;
+// UTC, synced with the Date of every EFA response.
+LocalClock localClock;
+// Local time minus UTC, from the serverTime of the EFA responses.
+int32_t utcOffset;
+bool utcOffsetKnown = false;
+// serverTime and Date are read at slightly different moments.
+static constexpr int32_t SERVER_TIME_TOLERANCE_S{60};
+
+// Also ask NTP for the time now and then, to see whether the EFA server's clock
+// can be trusted. Not needed otherwise.
+#ifndef NTP_CROSS_CHECK
+#define NTP_CROSS_CHECK 0
+#endif
+#if NTP_CROSS_CHECK
 WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP);
+static const char NTP_SERVER[] = "pool.ntp.org";
+static constexpr uint16_t NTP_PORT{123};
+static constexpr uint16_t NTP_LOCAL_PORT{1337};
+static constexpr uint32_t NTP_TIMEOUT_MS{1'000};
+static constexpr uint32_t NTP_CHECK_INTERVAL_MS{60 * 60 * 1000};
+#endif
 
-const String host = "fahrtauskunft.avv-augsburg.de";
+// Can be pointed at bench/mock_efa.py in secrets.h.
+#ifndef EFA_HOST
+#define EFA_HOST "fahrtauskunft.avv-augsburg.de"
+// certs.h has the fingerprint of this host only.
+#define EFA_PINNED
+#endif
+#ifndef EFA_PORT
+#define EFA_PORT 443
+#endif
+
+const String host = EFA_HOST;
+
+#ifdef EFA_STOP_ID
+// Built from EFA_STOP_ID in setup() instead of copied from the website, see
+// efa_request.h.
+static char uri[256];
+// The departures are counted over all platforms of the stop. Twice what the
+// display shows leaves room for departures that already left and those of
+// other platforms. A stop with many more platforms than are shown needs more,
+// which can be set in secrets.h.
+#ifndef EFA_DEPARTURE_LIMIT
+#define EFA_DEPARTURE_LIMIT (2 * NUM_PLATFORMS * NUM_STOPS)
+#endif
+static_assert(EFA_DEPARTURE_LIMIT > 0 && EFA_DEPARTURE_LIMIT <= UINT8_MAX, "EFA_DEPARTURE_LIMIT out of range");
+#endif
 
 char errorBuffer[1000];
 
@@ -131,14 +226,26 @@ void printTime(const DateTime &now) {
 	display.print(text);
 }
 
+// Whether every row of the display is taken.
+bool stopsFull() {
+	return formattedStops.platform_a.count == NUM_STOPS
+		&& formattedStops.platform_e.count == NUM_STOPS;
+}
+
+// The platforms we have a column for.
+bool showPlatform(char const platform) {
+	return platform == 'a' || platform == 'e';
+}
+
+// Returns false once there is no room left for more stops.
 bool addStop(ParsedStopEvent const &stop_event, DateTime const &nowUtc) {
-	if (stop_event.platform != 'a' && stop_event.platform != 'e') return true;
+	if (!showPlatform(stop_event.platform)) return true;
 
 	FormattedPlatform &platform = stop_event.platform == 'a'
 		? formattedStops.platform_a : formattedStops.platform_e;
 
 	if (platform.count == NUM_STOPS) {
-		return true;
+		return !stopsFull();
 	}
 
 	// Prefer departureTimeEstimated, fallback to departureTimePlanned.
@@ -164,12 +271,54 @@ bool addStop(ParsedStopEvent const &stop_event, DateTime const &nowUtc) {
 	snprintf(platform.buffer[platform.count++], BUF_LEN,
 		"%-3d   %3d min", stop_event.number, minutes);
 
-	return true;
+	return !stopsFull();
 }
 
-int fetchStops(DateTime const &nowUtc, DateTime &nowLocal) {
-	http.begin(client, host, 443, uri);
+static bool httpConnected(void *) {
+	return http.connected();
+}
+
+// Least stack ever left free, in bytes. The parse in fetchStops is about the
+// deepest the stack gets.
+static uint32_t freeStackLowWater() {
+#ifdef ESP32
+	// The ESP32 port of FreeRTOS counts in bytes, not words.
+	return uxTaskGetStackHighWaterMark(nullptr);
+#else
+	return ESP.getFreeContStack();
+#endif
+}
+
+// Sets nowUtc from the Date of the response before parsing it and nowLocal
+// afterwards. nowLocalKnown is false if neither this response nor an earlier
+// one had a serverTime to tell the local time by.
+int fetchStops(DateTime &nowUtc, DateTime &nowLocal, bool &nowLocalKnown) {
+	uint32_t requestMillis = millis();
+	// The connection of the last refresh is kept open unless the server closed
+	// it or we dropped it.
+	bool reused = client.connected();
+	http.begin(client, host, EFA_PORT, uri);
+#if ACCEPT_GZIP
+	// HTTPClient sends an Accept-Encoding of its own, which only lists
+	// identity. Servers go by whether gzip is mentioned at all.
+	http.addHeader("Accept-Encoding", "gzip");
+#endif
+	const char *responseHeaders[] = {"Content-Encoding", "Transfer-Encoding", "Date"};
+	http.collectHeaders(responseHeaders, sizeof(responseHeaders) / sizeof(responseHeaders[0]));
 	int httpCode = http.GET();
+	// The server or something in between can forget a kept connection without
+	// telling us. Don't count that as a failed try.
+	if (httpCode < 0 && reused) {
+		Serial.printf("[HTTPS] Kept connection is gone (%s), reconnecting\n",
+				http.errorToString(httpCode).c_str());
+		client.stop();
+		reused = false;
+		httpCode = http.GET();
+	}
+	// Connecting, the TLS handshake and the response headers
+	uint32_t const responseMillis = millis();
+	requestMillis = responseMillis - requestMillis;
+	Serial.printf("[HTTPS] %s connection\n", reused ? "Reused" : "New");
 
 	if (!(httpCode == HTTP_CODE_OK || httpCode == HTTP_CODE_MOVED_PERMANENTLY)) {
 		printError("[HTTPS] GET... failed with error code %d, error: %s\n",
@@ -178,8 +327,43 @@ int fetchStops(DateTime const &nowUtc, DateTime &nowLocal) {
 		return 1;
 	}
 
+	// The server read its clock somewhere between sending the request and
+	// receiving the headers, and Date leaves out the milliseconds.
+	uint32_t dateTime;
+	if (http_date(http.header("Date").c_str(), &dateTime)) {
+		localClock.sync(responseMillis - requestMillis / 2, (uint64_t)dateTime * 1000 + 500,
+			requestMillis / 2 + 500);
+	} else {
+		Serial.println("[Clock] No Date in the response");
+	}
+	if (!localClock.synced()) {
+		printError("[Clock] No time from the server\n");
+		client.stop();
+		http.end();
+		return 1;
+	}
+	nowUtc = DateTime(localClock.unixTime(responseMillis));
+	Serial.printf("[Clock] %02d:%02d:%02d UTC, off by up to %u ms, drift %d ppb (up to %u ppb off)\n",
+		nowUtc.hour(), nowUtc.minute(), nowUtc.second(), (unsigned)localClock.uncertainty(responseMillis),
+		(int)localClock.drift(), (unsigned)localClock.driftUncertainty());
+
 	Serial.printf("HTTP response size: %d\n", http.getSize());
-	Stream &stream = http.getStream();
+	// Transfer codings other than chunked are not used in practice.
+	bool chunked = http.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+	HttpBody body;
+	body.begin(http.getStream(), chunked, http.getSize());
+
+	// Servers may compress even if we didn't ask.
+	String contentEncoding = http.header("Content-Encoding");
+	bool compressed = contentEncoding == "gzip" || contentEncoding == "deflate";
+	if (compressed) {
+		Serial.printf("[HTTPS] Response is %s\n", contentEncoding.c_str());
+	} else if (contentEncoding.length() > 0 && contentEncoding != "identity") {
+		printError("[HTTPS] Unsupported Content-Encoding %s\n", contentEncoding.c_str());
+		client.stop();
+		http.end();
+		return 1;
+	}
 
 	memset(&formattedStops, 0, sizeof(formattedStops));
 
@@ -187,16 +371,120 @@ int fetchStops(DateTime const &nowUtc, DateTime &nowLocal) {
 		.serverLocalTime = nowLocal,
 		.nowUtc = nowUtc,
 		.stopCallback = addStop,
+		.platformFilter = showPlatform,
 	};
 
-	jimp_begin(&jimp, stream, &stopParserUserData);
+	// The parser state lives on this stack frame and jimp keeps none of its
+	// own. The rest of what a fetch touches (http, client, formattedStops and
+	// localClock) is global, so fetchStops still must not run on two tasks at
+	// once. See freeStackLowWater() for how much room the parse leaves.
+	char jimpArena[JIMP_ARENA_SIZE];
+	Jimp jimp = {0};
+	jimp_arena(&jimp, jimpArena, sizeof(jimpArena), JIMP_OVERFLOW_TRUNCATE);
+
+	StopPushParser stopPushParser;
+	parse_stops_push_begin(&jimp, &stopPushParser, &stopParserUserData);
+
+	std::unique_ptr<Inflater> inflater;
+	if (compressed) {
+		inflater.reset(new (std::nothrow) Inflater);
+		if (!inflater) {
+			printError("[HTTPS] No memory to inflate the response\n");
+			client.stop();
+			http.end();
+			return 1;
+		}
+		inflate_begin(&inflater->inflate, contentEncoding == "gzip" ? INFLATE_GZIP : INFLATE_ZLIB,
+			inflater->window, sizeof(inflater->window), body_parser_sink, &jimp);
+	}
+
+	BodyParser bodyParser = {
+		.jimp = &jimp,
+		.body = &body,
+		.inflate = compressed ? &inflater->inflate : nullptr,
+		.connected = httpConnected,
+	};
+	uint32_t bodyMillis = millis();
+	BodyStatus const bodyStatus = body_parser_run(&bodyParser, STALL_TIMEOUT_MS);
+	bodyMillis = millis() - bodyMillis;
+
+#if JIMP_STATS
+	// Whatever the body took beyond reading and parsing was spent waiting for
+	// the server or the network.
+	Serial.printf("[JSON] %u of %d bytes, request %u ms, body %u ms: read %u ms, parse %u ms\n",
+		(unsigned)jimp.stats.bytes, http.getSize(), (unsigned)requestMillis, (unsigned)bodyMillis,
+		(unsigned)(jimp.stats.wait_us / 1000), (unsigned)(jimp.stats.parse_us / 1000));
+	Serial.printf("[JSON] %u tokens, %u bytes skipped, %u bytes copied, longest token %u of %u bytes\n",
+		(unsigned)jimp.stats.tokens, (unsigned)jimp.stats.bytes_skipped,
+		(unsigned)jimp.stats.bytes_materialized, (unsigned)jimp.stats.peak_string,
+		(unsigned)jimp.string_capacity);
+#endif
+	if (compressed) {
+		Serial.printf("[HTTPS] Inflated to %u bytes in %u ms, parsing included\n",
+			(unsigned)inflater->inflate.total, (unsigned)(bodyParser.inflateMicros / 1000));
+	}
 
-	if (!parse_stops(&jimp)) {
-		printError("[JSON] Failed to jimp\n");
+	if (bodyStatus != BODY_PARSED) {
+		switch (bodyStatus) {
+		case BODY_INVALID_CHUNKING:
+			printError("[HTTPS] Invalid chunked response\n");
+			break;
+		case BODY_INVALID_COMPRESSION:
+			printError("[HTTPS] Invalid compressed response\n");
+			break;
+		case BODY_STALLED:
+			printError("[HTTPS] No data for %u ms\n", STALL_TIMEOUT_MS);
+			break;
+		default:
+			printError("[JSON] Failed to jimp\n");
+			break;
+		}
+		// The rest of the response would get in the way of the next one.
+		client.stop();
 		http.end();
 		return 1;
 	}
 
+	// The response changed in a way we can live with. Worth a look, but not
+	// worth fetching it again.
+	if (jimp.unexpected_members > 0) {
+		Serial.printf("[JSON] Skipped %u unexpected members\n", jimp.unexpected_members);
+	}
+
+	// Also when the display filled up before the end of the response, which is
+	// most of the time. Reading the rest is cheaper than connecting again,
+	// especially on the ESP32, which can't resume the TLS session.
+	if (jimp.stopped) {
+		Serial.println("[JSON] Display full, reading the rest of the response");
+	}
+	if (!body_parser_finish(&bodyParser, BODY_END_TIMEOUT_MS)) {
+		// The next request on this connection would start with the rest.
+		Serial.println("[HTTPS] Rest of the response didn't come, closing connection");
+		client.stop();
+	}
+
+	// serverTime is local time. The offset to UTC is in whole quarter hours
+	// everywhere, which leaves room for the server's delay.
+	if (stopParserUserData.serverTimeRead) {
+		int32_t const serverOffset = (nowLocal - nowUtc).totalseconds();
+		int32_t const offset = (serverOffset + (serverOffset >= 0 ? 450 : -450)) / 900 * 900;
+		if (abs(serverOffset - offset) <= SERVER_TIME_TOLERANCE_S) {
+			if (!utcOffsetKnown || offset != utcOffset) {
+				Serial.printf("[Clock] UTC offset %+d min\n", (int)(offset / 60));
+			}
+			utcOffset = offset;
+			utcOffsetKnown = true;
+		} else {
+			Serial.printf("[Clock] serverTime is %d s off any UTC offset\n", (int)(serverOffset - offset));
+		}
+	} else {
+		Serial.println("[Clock] No serverTime in the response");
+	}
+	if (utcOffsetKnown) {
+		nowLocal = DateTime(localClock.unixTime(millis())) + TimeSpan(utcOffset);
+	}
+	nowLocalKnown = utcOffsetKnown || stopParserUserData.serverTimeRead;
+
 	// Round to the closest minute
 	if (nowLocal.second() > 30) {
 		nowLocal = nowLocal + TimeSpan(60);
@@ -206,16 +494,66 @@ int fetchStops(DateTime const &nowUtc, DateTime &nowLocal) {
 	return 0;
 }
 
-DateTime getCurrentTime() {
-	if (!timeClient.forceUpdate()) {
-		Serial.println("Could not update NTP time. Using millis time. Will try again next refresh.");
+#if NTP_CROSS_CHECK
+// Asks the NTP server for the time, give or take uncertainty, at localMillis.
+bool ntpTime(uint32_t *localMillis, uint64_t *unixMillis, uint32_t *uncertainty) {
+	uint8_t packet[NTP_PACKET_SIZE];
+	ntp_request(packet);
+	// Late answers to an earlier request
+	while (ntpUDP.parsePacket() > 0) {
+		ntpUDP.flush();
+	}
+
+	uint32_t const sentMillis = millis();
+	if (!ntpUDP.beginPacket(NTP_SERVER, NTP_PORT)
+			|| ntpUDP.write(packet, sizeof(packet)) != sizeof(packet)
+			|| !ntpUDP.endPacket()) {
+		return false;
+	}
+	int size;
+	while ((size = ntpUDP.parsePacket()) == 0) {
+		if (millis() - sentMillis > NTP_TIMEOUT_MS) {
+			return false;
+		}
+		delay(1);
+	}
+	uint32_t const roundTrip = millis() - sentMillis;
+
+	if (size < (int)sizeof(packet)
+			|| ntpUDP.read(packet, sizeof(packet)) != (int)sizeof(packet)
+			|| !ntp_response(packet, unixMillis)) {
+		return false;
 	}
+	// The server read its clock somewhere during the round trip.
+	*localMillis = sentMillis + roundTrip / 2;
+	*uncertainty = roundTrip / 2 + 1;
+	return true;
+}
 
-	DateTime now(timeClient.getEpochTime());
-	Serial.print("Got current time: ");
-	Serial.println(timeClient.getFormattedTime());
-	return now;
+// Compares the clock with NTP once an hour. Only logs, the clock keeps
+// following the EFA server.
+void checkClock() {
+	static uint32_t checkMillis;
+	static bool checked = false;
+	if (!localClock.synced() || (checked && millis() - checkMillis < NTP_CHECK_INTERVAL_MS)) {
+		return;
+	}
+	checked = true;
+	checkMillis = millis();
+
+	uint32_t localMillis, uncertainty;
+	uint64_t unixMillis;
+	if (!ntpTime(&localMillis, &unixMillis, &uncertainty)) {
+		Serial.println("[Clock] Could not get NTP time");
+		return;
+	}
+	int64_t const difference = (int64_t)(localClock.unixMillis(localMillis) - unixMillis);
+	uint64_t const allowed = (uint64_t)localClock.uncertainty(localMillis) + uncertainty;
+	Serial.printf("[Clock] %s NTP by %d ms, up to %u ms expected\n",
+		(uint64_t)(difference < 0 ? -difference : difference) <= allowed ? "Agrees with" : "DISAGREES with",
+		(int)difference, (unsigned)allowed);
 }
+#endif
 
 // Text height plus a bit extra to push the main text away from the clock
 static constexpr uint16_t TOP_PADDING{40};
@@ -232,12 +570,11 @@ void refresh() {
 	Serial.println("Refresh");
 	Serial.printf("Free heap: %u bytes\n", ESP.getFreeHeap());
 
-	// Use NTP to get current UTC time and use API to get current local time.
-	// Current UTC time needed because stop events are in UTC.
-	// Current local time use to print time in the corner.
-	Serial.println("Getting current time...");
-	DateTime const nowUtc{getCurrentTime()};
+	// Both come with the response. Current UTC time needed because stop events
+	// are in UTC. Current local time use to print time in the corner.
+	DateTime nowUtc;
 	DateTime nowLocal;
+	bool nowLocalKnown = false;
 
 	Serial.println("Fetching stops....");
 
@@ -245,13 +582,17 @@ void refresh() {
 		if (i == NUM_RETRIES) {
 			return;
 		}
-		if (fetchStops(nowUtc, nowLocal) == 0) {
+		if (fetchStops(nowUtc, nowLocal, nowLocalKnown) == 0) {
 			break;
 		} else {
 			Serial.printf("Error during fetchstops (try %d): %s\n", i, errorBuffer);
 		}
 		delay(1000);
 	}
+	Serial.printf("Free stack: at least %u bytes\n", (unsigned)freeStackLowWater());
+#if NTP_CROSS_CHECK
+	checkClock();
+#endif
 
 	const uint16_t topPadding =
 		(display.height() - TEXT_BLOCK_HEIGHT) / 2u + TOP_PADDING;
@@ -271,7 +612,10 @@ void refresh() {
 	display.firstPage();
 	do {
 		display.fillScreen(GxEPD_WHITE);
-		printTime(nowLocal);
+		// Rather no clock than a wrong one.
+		if (nowLocalKnown) {
+			printTime(nowLocal);
+		}
 		for (uint8_t i{0}; i < NUM_LINES; i++) {
 			display.setCursor(leftPadding, topPadding + i * LINE_SPACING);
 			display.print(0 == i ? "  Into city" :
@@ -286,8 +630,8 @@ void refresh() {
 		}
 	} while (display.nextPage());
 
-	Serial.print("Done refresh at ");
-	Serial.println(timeClient.getFormattedTime());
+	DateTime const doneUtc(localClock.unixTime(millis()));
+	Serial.printf("Done refresh at %02d:%02d:%02d UTC\n", doneUtc.hour(), doneUtc.minute(), doneUtc.second());
 }
 
 char * e2s(int Status){
@@ -309,6 +653,53 @@ char * e2s(int Status){
     }
 }
 
+#ifndef ESP32
+// BearSSL buffers a whole TLS record, so by default it takes 16 KiB for
+// receiving. If the server agrees to a maximum fragment length (RFC 6066), the
+// buffer only has to hold that.
+static constexpr uint16_t TLS_MAX_FRAGMENT_LENGTH{1024};
+// The request fits into one record of this size.
+static constexpr uint16_t TLS_TRANSMIT_BUFFER_SIZE{512};
+
+// Elliptic curve key exchange and AES-GCM only. The last one is for when the
+// server's certificate has an RSA key.
+static const uint16_t TLS_CIPHERS[] = {
+	BR_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+	BR_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+	BR_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+};
+#endif
+
+void setupTls() {
+#ifdef ESP32
+	// The Arduino core for the ESP32 neither lets mbedTLS negotiate the fragment
+	// length nor restrict the ciphers, and it can only check SHA-256
+	// fingerprints, while certs.h has a SHA-1 one. There is enough RAM anyway.
+	client.setInsecure();
+#else
+	// Asks the server in a connection of its own, so do it once.
+	if (WiFiClientSecureType::probeMaxFragmentLength(EFA_HOST, EFA_PORT, TLS_MAX_FRAGMENT_LENGTH)) {
+		client.setBufferSizes(TLS_MAX_FRAGMENT_LENGTH, TLS_TRANSMIT_BUFFER_SIZE);
+		Serial.printf("[TLS] Maximum fragment length %u\n", TLS_MAX_FRAGMENT_LENGTH);
+	} else {
+#if TLS_SERVER_HAS_MFLN
+		// The display buffer was sized for the small TLS buffers, so the full
+		// ones may not fit next to it.
+		printError("[TLS] Server refused the maximum fragment length, build with TLS_SERVER_HAS_MFLN 0\n");
+#else
+		Serial.printf("[TLS] No maximum fragment length, using full buffers\n");
+#endif
+	}
+	client.setCiphers(TLS_CIPHERS, sizeof(TLS_CIPHERS) / sizeof(TLS_CIPHERS[0]));
+#ifdef EFA_PINNED
+	client.setFingerprint(fingerprint_fahrtauskunft_avv_augsburg_de);
+#else
+	client.setInsecure();
+#endif
+	client.setSession(&tlsSession);
+#endif
+}
+
 void setup() {
 	Serial1.begin(115200);
 	Serial.begin(115200);
@@ -330,13 +721,31 @@ void setup() {
 	printError("IP Address: %s", WiFi.localIP().toString().c_str());
 	Serial.printf("%s\n", errorBuffer);
 
-	client.setInsecure();
-	// client.setFingerprint(fingerprint_fahrtauskunft_avv_augsburg_de);
-	// client.getFingerprintSHA256(fingerprint_fahrtauskunft_avv_augsburg_de);
+#ifdef EFA_STOP_ID
+	EfaDepartureRequest const request{
+		.stopId = EFA_STOP_ID,
+		.limit = EFA_DEPARTURE_LIMIT,
+		.realtime = true,
+	};
+	if (efa_departure_request_uri(uri, sizeof(uri), request) == 0) {
+		// Every fetch would ask for the wrong thing, so don't fetch at all.
+		printError("Request for stop %s too long\n", EFA_STOP_ID);
+		Serial.printf("%s", errorBuffer);
+		for (;;) {
+			delay(1000);
+		}
+	}
+	Serial.printf("Request: %s\n", uri);
+#endif
+
+	setupTls();
+	// Keep the connection open between refreshes instead of paying for DNS,
+	// TCP and a TLS handshake every minute.
+	http.setReuse(true);
 
-	timeClient.begin();
-	// Stop events are in UTC.
-	timeClient.setTimeOffset(0);
+#if NTP_CROSS_CHECK
+	ntpUDP.begin(NTP_LOCAL_PORT);
+#endif
 }
 
 void loop() {
@@ -344,7 +753,7 @@ void loop() {
 
 	// Calculate the number of seconds to wait so we line up on the minute for the
 	// next update
-	uint32_t msToWait = 60'000 - (timeClient.getSeconds() * 1000);
+	uint32_t msToWait = 60'000 - localClock.unixMillis(millis()) % 60'000;
 
 	// Wait at least 30 seconds.
 	if (msToWait < 30'000) {
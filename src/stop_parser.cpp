@@ -1,184 +1,74 @@
 #include "stop_parser.h"
 
-static bool parse_server_info(Jimp *jimp) {
-	if (!jimp_object_begin(jimp)) return false;
+// The parts of the departure monitor response we need. Everything else is
+// skipped without being looked at, so new or reordered members in the response
+// don't break us. The Known lists are what the response had when this was
+// written, anything else gets counted in jimp->unexpected_members. See
+// jimp_schema.h.
 
-	while (jimp_object_member(jimp)) {
-		if (strcmp(jimp->string, "serverTime") == 0) {
-			if (!jimp_string(jimp)) return false;
-			reinterpret_cast<StopParserUserData*>(jimp->user_data)->serverLocalTime =
-				DateTime(jimp->string);
-		} else if (strcmp(jimp->string, "calcTime") == 0) {
-			if (!jimp_number(jimp)) return false;
-		} else {
-			if (!jimp_string(jimp)) return false;
-		}
-	}
-
-	if (!jimp_object_end(jimp)) return false;
-
-	return true;
-}
-
-static bool parse_location_properties(Jimp *jimp, char * platform) {
-	if (!jimp_object_begin(jimp)) return false;
-
-	while (jimp_object_member(jimp)) {
-		if (strcmp(jimp->string, "platform") == 0) {
-			if (!jimp_string(jimp)) return false;
-			*platform = *jimp->string;
-		} else {
-			if (!jimp_string(jimp)) return false;
-		}
-	}
-
-	if (!jimp_object_end(jimp)) return false;
+using namespace jimp_schema;
 
+static bool set_server_time(Jimp *jimp, StopParserState &state) {
+	state.userData->serverLocalTime = DateTime(jimp->string);
+	state.userData->serverTimeRead = true;
 	return true;
 }
 
-static bool parse_location(Jimp *jimp, char * platform) {
-	if (!jimp_object_begin(jimp)) return false;
-
-	while (jimp_object_member(jimp)) {
-		if (strcmp(jimp->string, "id") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "isGlobalId") == 0) {
-			if (!jimp_bool(jimp)) return false;
-		} else if (strcmp(jimp->string, "name") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "disassembledName") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "type") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "pointType") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "coord") == 0) {
-			if (!jimp_skip_array(jimp)) return false;
-		} else if (strcmp(jimp->string, "properties") == 0) {
-			if (!parse_location_properties(jimp, platform)) return false;
-		} else if (strcmp(jimp->string, "parent") == 0) {
-			if (!jimp_skip_object(jimp)) return false;
-		} else {
-			jimp_unknown_member(jimp);
-			return false;
-		}
+static bool accept_platform(StopParserState const &state, ParsedStopEvent const &stopEvent) {
+	if (state.full) {
+		return false;
 	}
-
-	if (!jimp_object_end(jimp)) return false;
-
-	return true;
-}
-
-static bool parse_transportation(Jimp *jimp, int * number) {
-	if (!jimp_object_begin(jimp)) return false;
-
-	while (jimp_object_member(jimp)) {
-		if (strcmp(jimp->string, "id") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "name") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "disassembledName") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "description") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "number") == 0) {
-			if (!jimp_string(jimp)) return false;
-			*number = atoi(jimp->string);
-		} else if (strcmp(jimp->string, "product") == 0) {
-			if (!jimp_skip_object(jimp)) return false;
-		} else if (strcmp(jimp->string, "destination") == 0) {
-			if (!jimp_skip_object(jimp)) return false;
-		} else if (strcmp(jimp->string, "properties") == 0) {
-			if (!jimp_skip_object(jimp)) return false;
-		} else if (strcmp(jimp->string, "origin") == 0) {
-			if (!jimp_skip_object(jimp)) return false;
-		} else if (strcmp(jimp->string, "operator") == 0) {
-			if (!jimp_skip_object(jimp)) return false;
-		} else {
-			jimp_unknown_member(jimp);
-			return false;
-		}
-	}
-
-	if (!jimp_object_end(jimp)) return false;
-	return true;
+	bool (* const platformFilter)(char) = state.userData->platformFilter;
+	return !platformFilter || platformFilter(stopEvent.platform);
 }
 
-static bool parse_stop_event(Jimp *jimp) {
-	ParsedStopEvent result{};
-	if (!jimp_object_begin(jimp)) return false;
-
-	while (jimp_object_member(jimp)) {
-		if (strcmp(jimp->string, "realtimeStatus") == 0) {
-			if (!jimp_skip_array(jimp)) return false;
-		} else if (strcmp(jimp->string, "isRealtimeControlled") == 0) {
-			if (!jimp_bool(jimp)) return false;
-		} else if (strcmp(jimp->string, "location") == 0) {
-			if (!parse_location(jimp, &result.platform)) return false;
-		} else if (strcmp(jimp->string, "departureTimePlanned") == 0) {
-			if (!jimp_string(jimp)) return false;
-			result.departureTimePlanned = DateTime(jimp->string);
-		} else if (strcmp(jimp->string, "departureTimeEstimated") == 0) {
-			if (!jimp_string(jimp)) return false;
-			result.hasDepartureTimeEstimated = true;
-			result.departureTimeEstimated = DateTime(jimp->string);
-		} else if (strcmp(jimp->string, "departureTimeBaseTimetable") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "transportation") == 0) {
-			if (!parse_transportation(jimp, &result.number)) return false;
-		} else if (strcmp(jimp->string, "properties") == 0) {
-			if (!jimp_skip_object(jimp)) return false;
-		} else {
-			jimp_unknown_member(jimp);
-			return false;
-		}
+static bool stop_event_done(StopParserState &state, ParsedStopEvent const &stopEvent) {
+	if (state.userData->stopCallback(stopEvent, state.userData->nowUtc)) {
+		return true;
 	}
-
-	if (!jimp_object_end(jimp)) return false;
-
-	StopParserUserData * const user_data =
-		reinterpret_cast<StopParserUserData *>(jimp->user_data);
-
-	user_data->stopCallback(result, user_data->nowUtc);
-
-	return true;
+	// The local time is worth reading the rest for, which the server may send
+	// after the stop events.
+	state.full = !state.userData->serverTimeRead;
+	return state.full;
 }
 
-static bool parse_stop_events(Jimp *jimp) {
-	if (!jimp_array_begin(jimp)) return false;
-
-	while (jimp_array_item(jimp)) {
-		if (!parse_stop_event(jimp)) return false;
-	}
-
-	if (!jimp_array_end(jimp)) return false;
-
-	return true;
-}
+using StopEventSchema = Object<
+	Member<JIMP_KEY("location"), Object<
+		Member<JIMP_KEY("properties"), Object<
+			Member<JIMP_KEY("platform"),
+				Filter<FirstChar<&ParsedStopEvent::platform>, accept_platform>>
+		>>,
+		Known<JIMP_KEY("id"), JIMP_KEY("isGlobalId"), JIMP_KEY("name"),
+			JIMP_KEY("disassembledName"), JIMP_KEY("type"), JIMP_KEY("pointType"),
+			JIMP_KEY("coord"), JIMP_KEY("parent")>
+	>>,
+	Member<JIMP_KEY("departureTimePlanned"), Time<&ParsedStopEvent::departureTimePlanned>>,
+	Member<JIMP_KEY("departureTimeEstimated"), Nullable<
+		Time<&ParsedStopEvent::departureTimeEstimated, &ParsedStopEvent::hasDepartureTimeEstimated>>>,
+	Member<JIMP_KEY("transportation"), Nullable<Object<
+		Member<JIMP_KEY("number"), Atoi<&ParsedStopEvent::number>>,
+		Known<JIMP_KEY("id"), JIMP_KEY("name"), JIMP_KEY("disassembledName"),
+			JIMP_KEY("description"), JIMP_KEY("product"), JIMP_KEY("destination"),
+			JIMP_KEY("properties"), JIMP_KEY("origin"), JIMP_KEY("operator")>
+	>>>,
+	Known<JIMP_KEY("realtimeStatus"), JIMP_KEY("isRealtimeControlled"),
+		JIMP_KEY("departureTimeBaseTimetable"), JIMP_KEY("properties")>
+>;
+
+using StopsSchema = Object<
+	Member<JIMP_KEY("serverInfo"), Object<
+		Member<JIMP_KEY("serverTime"), Call<set_server_time>>
+	>>,
+	Member<JIMP_KEY("stopEvents"), Each<&StopParserState::stopEvent, StopEventSchema, stop_event_done>>,
+	Known<JIMP_KEY("version"), JIMP_KEY("systemMessages"), JIMP_KEY("locations")>
+>;
 
 bool parse_stops(Jimp *jimp) {
-	if (!jimp_object_begin(jimp)) return false;
-
-	while (jimp_object_member(jimp)) {
-		if (strcmp(jimp->string, "serverInfo") == 0) {
-			if (!parse_server_info(jimp)) return false;
-		} else if (strcmp(jimp->string, "version") == 0) {
-			if (!jimp_string(jimp)) return false;
-		} else if (strcmp(jimp->string, "systemMessages") == 0) {
-			if (!jimp_array_begin(jimp)) return false;
-			if (!jimp_array_end(jimp)) return false;
-		} else if (strcmp(jimp->string, "locations") == 0) {
-			if (!jimp_skip_array(jimp)) return false;
-		} else if (strcmp(jimp->string, "stopEvents") == 0) {
-			if (!parse_stop_events(jimp)) return false;
-		} else {
-			jimp_unknown_member(jimp);
-			return false;
-		}
-	}
-
-	if (!jimp_object_end(jimp)) return false;
+	StopParserState state{reinterpret_cast<StopParserUserData *>(jimp->user_data), {}, false};
+	return jimp_schema::parse<StopsSchema>(jimp, state);
+}
 
-	return true;
+void parse_stops_push_begin(Jimp *jimp, StopPushParser *parser, StopParserUserData *userData) {
+	parser->state = StopParserState{userData, {}, false};
+	push_begin<StopsSchema>(jimp, &parser->schema, &parser->state);
 }
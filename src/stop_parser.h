@@ -2,6 +2,7 @@
 #define STOP_PARSER
 
 #include "jimp.h"
+#include "jimp_schema.h"
 #include "datetime.h"
 
 struct ParsedStopEvent {
@@ -15,9 +16,39 @@ struct ParsedStopEvent {
 struct StopParserUserData {
 	DateTime &serverLocalTime;
 	DateTime const &nowUtc;
+	// Called for every stop event. Returning false means it has enough: the
+	// parse ends successfully without reading the rest, see Jimp::stopped. If
+	// serverTime hasn't come yet, the parse goes on until it does, skipping the
+	// remaining stop events.
 	bool (*stopCallback)(ParsedStopEvent const &, DateTime const &);
+	// Optional. Asked as soon as the platform of a stop event is known. Events
+	// on platforms it turns down are skipped without parsing the rest of them
+	// and never reach stopCallback.
+	bool (*platformFilter)(char platform);
+	// Set once serverLocalTime has been read. The response may not have it.
+	bool serverTimeRead = false;
+};
+
+// Where parse_stops puts what it reads. stopEvent is reused for every element
+// of stopEvents.
+struct StopParserState {
+	StopParserUserData *userData;
+	ParsedStopEvent stopEvent;
+	// stopCallback had enough before serverTime was read.
+	bool full;
 };
 
 bool parse_stops(Jimp *jimp);
 
+// Push mode variant of parse_stops. Start it with parse_stops_push_begin and
+// then hand the response to jimp_push_feed in chunks of any size.
+
+// Everything the push mode parse needs to resume between two chunks.
+struct StopPushParser {
+	StopParserState state;
+	jimp_schema::PushParser schema;
+};
+
+void parse_stops_push_begin(Jimp *jimp, StopPushParser *parser, StopParserUserData *userData);
+
 #endif // STOP_PARSER